@@ -0,0 +1,245 @@
+// Self-checks and benchmarks of the checker, kept out of the checker itself. This file includes main.cpp, so it is
+// built on its own instead of alongside it:
+//     g++ -O2 -std=c++17 -pthread checks.cpp -o checks
+// and run with the name of one check, e.g. ./checks --check-allocations. Counting allocations needs
+// -DTRACK_ALLOCATIONS as well.
+#define main checkerMain
+#include "main.cpp"
+#undef main
+
+// Checks a generated file of 10 statements and one of 1000, for --check-allocations. The statements include
+// bare calls, so function calls are matched to their signatures as well as expressions being typed.
+// Returns 0 if the expressions and calls phases made no more allocations for the larger file than for the
+// smaller, otherwise 1. Always 1 unless the checks were built with -DTRACK_ALLOCATIONS.
+// Preconditions: Nothing else has been checked.
+// Postconditions: The counts are printed.
+int checkAllocations();
+
+// Lexes 20000 random inputs built from pieces of Csimple, each with lexSource and with lexChunks split into a
+// random number of chunks, for --check-chunks. Also checks that a single task of runParallel may still use every
+// thread to lex in chunks.
+// Returns 0 if every input gave the same tokens and offsets both ways, otherwise 1.
+// Preconditions: None.
+// Postconditions: The result is printed. sourceText is overwritten.
+int checkChunks();
+
+// Times loading a generated prelude image, then measures how findSymbol's lookups in it scale with the number of
+// threads, against an unordered_map behind a mutex, for --bench-lookups. Scaling can only be seen with several
+// hardware threads.
+// Returns 0, or 1 if the prelude could not be written and loaded.
+// Preconditions: No prelude has been loaded.
+// Postconditions: The results are printed. The generated prelude stays loaded.
+int benchmarkLookups();
+
+int main(int argc, char* argv[])
+{
+	setupTables();
+	string argument = argc == 2 ? argv[1] : "";
+	if (argument == "--check-allocations")
+	{
+		return checkAllocations();
+	}
+	else if (argument == "--check-chunks")
+	{
+		return checkChunks();
+	}
+	else if (argument == "--bench-lookups")
+	{
+		return benchmarkLookups();
+	}
+	cout << "Usage: " << argv[0] << " --check-allocations | --check-chunks | --bench-lookups" << endl;
+	return 2;
+}
+
+int checkAllocations()
+{
+#ifdef TRACK_ALLOCATIONS
+	// the first check is not counted, since it fills buffers that every later check reuses
+	const int sizes[3] = {10, 10, 1000};
+	long long counts[3][2]; // the expressions and calls phases' allocations for each check
+	for (int s = 0; s < 3; s++)
+	{
+		ostringstream source;
+		source << "int f(int a, char c)\n{\n\treturn a;\n}\nvoid Main()\n{\n\tint x;\n\tchar c;\n\tbool b;\n"
+			"\tint *p;\n\tstring name;\n";
+		for (int i = 0; i < sizes[s]; i++)
+		{
+			source << "\tx = (x + 1) * |x - 2| / 3;\n\tc = name[x + 1];\n\tb = x < 3 && !(x == 2);\n\tf(x, c);\n"
+				"\tx = f(x, c);\n\tif (b) { p = &x; }\n";
+		}
+		source << "}\n";
+		
+		resetChecker();
+		sourceText = source.str();
+		vector<string> tokens;
+		vector<int> offsets;
+		addPadding(&tokens, &offsets, false);
+		lexSource(&tokens, &offsets, 0, -1);
+		addPadding(&tokens, &offsets, true);
+		long long before[2] = {allocationCounts[PHASE_EXPRESSIONS].load(), allocationCounts[PHASE_CALLS].load()};
+		ostringstream output;
+		diagnostics = &output;
+		bool passed = typeCheck(tokens, offsets, LEADING_PADDING);
+		diagnostics = &cout;
+		counts[s][0] = allocationCounts[PHASE_EXPRESSIONS].load() - before[0];
+		counts[s][1] = allocationCounts[PHASE_CALLS].load() - before[1];
+		if (!passed)
+		{
+			cout << "The generated file failed its check: " << output.str() << endl;
+			return 1;
+		}
+	}
+	
+	cout << left << setw(14) << "statements" << right << setw(14) << "expressions" << setw(14) << "calls" << endl;
+	for (int s = 1; s < 3; s++)
+	{
+		cout << left << setw(14) << sizes[s] * 6 << right << setw(14) << counts[s][0] << setw(14) << counts[s][1] << endl;
+	}
+	bool flat = counts[2][0] <= counts[1][0] && counts[2][1] <= counts[1][1];
+	cout << (flat ? "Allocations do not grow with the number of statements." : "Allocations grow with the number of statements.") << endl;
+	return flat ? 0 : 1;
+#else
+	cout << "Counting allocations needs the checks to be built with -DTRACK_ALLOCATIONS." << endl;
+	return 1;
+#endif
+}
+
+int checkChunks()
+{
+	const char* const pieces[] = {"int", " ", "x", "=", "==", "\n", "\"", "'", "a", "1", ".", "2", "(", ")", "{", "}",
+		";", "<", "&", "&&", "-", ">", "\r\n", "\t", "!=", "+"};
+	const int pieceCount = sizeof(pieces) / sizeof(pieces[0]);
+	const int INPUTS = 20000;
+	int outside = availableThreads();
+	int inside = 0;
+	runParallel(1, [&](int) {inside = availableThreads();});
+	if (inside != outside)
+	{
+		cout << "A single task of runParallel may only use " << inside << " of " << outside << " threads." << endl;
+		return 1;
+	}
+	
+	mt19937 random(7);
+	int mismatches = 0;
+	for (int input = 0; input < INPUTS; input++)
+	{
+		sourceText.clear();
+		int length = random() % 200;
+		for (int p = 0; p < length; p++)
+		{
+			sourceText += pieces[random() % pieceCount];
+		}
+		vector<string> tokens[2];
+		vector<int> offsets[2];
+		lexSource(&tokens[0], &offsets[0], 0, -1);
+		int chunkCount = 1 + random() % 12;
+		lexChunks(&tokens[1], &offsets[1], chunkCount);
+		if (tokens[0] != tokens[1] || offsets[0] != offsets[1])
+		{
+			if (mismatches == 0)
+			{
+				cout << "Lexing in " << chunkCount << " chunks differs for: " << sourceText << endl;
+			}
+			mismatches++;
+		}
+	}
+	cout << mismatches << " of " << INPUTS << " inputs lexed differently in chunks." << endl;
+	return mismatches == 0 ? 0 : 1;
+}
+
+int benchmarkLookups()
+{
+	const int NAME_COUNT = 200000;
+	const int LOOKUPS = 2000000; // per thread
+	const string imagePath = "bench-lookups.img";
+	
+	// a prelude of NAME_COUNT variables is compiled, then loaded as --prelude loads it
+	ostringstream source;
+	for (int n = 0; n < NAME_COUNT; n++)
+	{
+		source << "int symbol" << n << ";\n";
+	}
+	sourceText = source.str();
+	lineStarts.clear();
+	vector<string> tokens;
+	vector<int> offsets;
+	tokenizeSource("", &tokens, &offsets);
+	ostringstream output;
+	diagnostics = &output;
+	bool passed = typeCheck(tokens, offsets, LEADING_PADDING);
+	diagnostics = &cout;
+	if (!passed || !writePrelude(imagePath))
+	{
+		cout << "The benchmark's prelude could not be written to " << imagePath << "." << endl;
+		return 1;
+	}
+	chrono::steady_clock::time_point started = chrono::steady_clock::now();
+	bool loaded = loadPrelude(imagePath);
+	double loadTime = chrono::duration<double, milli>(chrono::steady_clock::now() - started).count();
+	remove(imagePath.c_str());
+	resetChecker(); // after the timed load, since freeing the checker's symbols slows the next large allocation
+	if (!loaded)
+	{
+		cout << "The benchmark's prelude could not be loaded." << endl;
+		return 1;
+	}
+	unordered_map<string, int> lockedTable;
+	for (int n = 0; n < NAME_COUNT; n++)
+	{
+		lockedTable.insert(pair<string, int>("symbol" + to_string(n), n));
+	}
+	mutex lock;
+	
+	// half the names looked up are declared and half are not, as with identifiers and literals
+	vector<string> queries;
+	for (int q = 0; q < 4096; q++)
+	{
+		queries.push_back((q % 2 == 0 ? "symbol" : "literal") + to_string((q * 7919) % NAME_COUNT));
+	}
+	
+	cout << "Lookup benchmark: a prelude of " << NAME_COUNT << " names loaded in " << fixed << setprecision(2) << loadTime
+		<< " ms, " << LOOKUPS << " lookups per thread." << endl;
+	cout << setw(8) << "threads" << setw(22) << "prelude (M/s)" << setw(22) << "mutex (M/s)" << endl;
+	int maxThreads = max<int>(2, thread::hardware_concurrency());
+	for (int threads = 1; threads <= maxThreads; threads *= 2)
+	{
+		double rates[2];
+		for (int locked = 0; locked < 2; locked++)
+		{
+			atomic<long long> found(0);
+			chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+			runParallel(threads, [&](int t)
+			{
+				long long hits = 0;
+				for (int l = 0; l < LOOKUPS; l++)
+				{
+					int q = (l + t * 613) & (queries.size() - 1);
+					if (locked)
+					{
+						lock_guard<mutex> guard(lock);
+						hits += lockedTable.find(queries[q]) != lockedTable.end();
+					}
+					else
+					{
+						hits += findSymbol(queries[q]) != NULL;
+					}
+				}
+				found += hits;
+			});
+			double seconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+			rates[locked] = (double)threads * LOOKUPS / seconds / 1e6;
+			if (found != (long long)threads * LOOKUPS / 2) // every other query is declared
+			{
+				cout << "Lookups returned the wrong result." << endl;
+			}
+		}
+		cout << setw(8) << threads << setw(22) << rates[0] << setw(22) << rates[1] << endl;
+	}
+	if (maxThreads > (int)thread::hardware_concurrency())
+	{
+		// runParallel never starts more threads than there are hardware threads
+		cout << "Only " << max<int>(1, thread::hardware_concurrency()) << " hardware thread(s): larger thread counts ran on that many "
+			"threads, so this run does not show how reads scale." << endl;
+	}
+	return 0;
+}
@@ -1,1048 +1,4733 @@
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <iomanip>
-#include <unordered_map> // need to add -std=c++11 under Tools->Compiler Options
+#include <algorithm>
+#include <cstring>
+#include <unordered_map> // need to add -std=c++14 under Tools->Compiler Options
 #include <unordered_set>
 #include <vector>
+#include <thread> // need to add -pthread under Tools->Compiler Options on older Linux toolchains
+#include <atomic>
+#include <functional>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <random>
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <sys/syscall.h>
+#if defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#endif
+#endif
+#if defined(IORING_FEAT_RW_CUR_POS) && defined(__NR_io_uring_setup) && defined(__NR_io_uring_register) // the read, openat and statx operations need Linux 5.6
+#define USE_IO_URING
+#endif
+#endif
+#ifndef _WIN32
+#include <dirent.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/wait.h>
+#endif
 using namespace std;
 
 // A class that holds all necessary information about variables and functions from the input file.
 class symbolInfo
 {
 	int scope; // the scope this symbol was initially declared on
-	string type; // the data type of this symbol
+	int type; // the data type of this symbol, as a valueType
 	vector<string> arguments; // the list of arguments the symbol accepts if it's a function
+	int signature; // the interned ID of the return type and argument list if it's a function, -1 otherwise
 	public:
-		symbolInfo(int s, string t) : scope(s), type(t) {}
-		symbolInfo(int s, string t, vector<string> a) : scope(s), type(t), arguments(a) {}
-		string getType() {return type;}
+		symbolInfo(int s, int t) : scope(s), type(t), signature(-1) {}
+		symbolInfo(int s, int t, vector<string> a, int sig) : scope(s), type(t), arguments(move(a)), signature(sig) {}
+		int getType() {return type;}
 		int getScope() {return scope;}
-		vector<string> getArguments() {return arguments;}
+		const vector<string>& getArguments() {return arguments;}
+		int getSignature() {return signature;}
 };
 
+// The checker's state is kept per thread, so several files can be checked at once.
+
 // The current scope of the file
-int fileScope = 0;
-// The current line number of the file
-int lineNo = 1;
+thread_local int fileScope = 0;
+// The byte offset of the construct currently being checked, used to locate errors
+thread_local int errorOffset = 0;
 // The current function the checker is in
-string currentFunc;
+thread_local string currentFunc;
+// The index of the ) closing the current function's arguments. Declarations before it are arguments.
+thread_local int argumentsEnd = 0;
+// Where messages from the checker are written.
+thread_local ostream* diagnostics = &cout;
+// The code of the last error shown.
+thread_local int lastError = 0;
+// When set, typeCheck gives up at the end of the next top-level unit once the flag is raised.
+thread_local const atomic<bool>* cancelCheck = NULL;
+// How many hardware threads the work on this thread may use, or 0 for all of them. runParallel gives each of its
+// threads an equal share of its own, so work is only split further when the outer work leaves threads idle.
+thread_local int threadShare = 0;
+
+// The parts of a check that allocations are attributed to when the checker is built with -DTRACK_ALLOCATIONS.
+enum checkPhase {PHASE_OTHER, PHASE_LEXING, PHASE_DECLARATIONS, PHASE_EXPRESSIONS, PHASE_CALLS, PHASE_COUNT};
+const char* const phaseNames[PHASE_COUNT] = {"other", "lexing", "declarations", "expressions", "calls"};
+// The phase this thread is in.
+thread_local int currentPhase = PHASE_OTHER;
+// Puts the thread in a phase for as long as it exists, then returns it to the phase it was in.
+struct phaseScope
+{
+	int previous;
+	phaseScope(int phase) : previous(currentPhase) {currentPhase = phase;}
+	~phaseScope() {currentPhase = previous;}
+};
+
+// The full text of the input file.
+thread_local string sourceText;
+// The byte offset each line of sourceText starts at. Only built once a diagnostic needs it.
+thread_local vector<int> lineStarts;
+// The directory the input file is in, where the interfaces of the modules it imports are found.
+thread_local string moduleDirectory;
 
 // The table (as a hash map) that holds all the data about the variables and functions, using their names as keys.
-unordered_map<string, symbolInfo*> symbolTable;
+thread_local unordered_map<string, symbolInfo*> symbolTable;
+// The names added to symbolTable, in the order they were added. Symbols are never removed while checking,
+// so the table can be rolled back to an earlier point by removing the names after it.
+thread_local vector<string> declarationLog;
+// The global declarations of the file, in the order they were declared. These are written to its interface.
+thread_local vector<string> exportedNames;
+// Every distinct function signature (return type and argument types) mapped to a unique ID.
+// Keys are written as "type(arg,arg)" so a call site can build the same key and compare IDs.
+thread_local unordered_map<string, int> signatureIds;
+// Scratch space for building signature keys, reused between calls.
+thread_local string signatureKey;
+
+// The mapped prelude image, or NULL if there is none. It is checked once when it is loaded and never changes, so
+// every thread reads it below its own symbolTable without locking.
+const char* preludeImage = NULL;
+int preludeCount = 0;
+const int* preludeRecords = NULL;
+int preludeSignatureCount = 0;
+const int* preludeSignatures = NULL;
+const int* preludeNameIndex = NULL;
+int preludeNameSlots = 0;
+const int* preludeSignatureIndex = NULL;
+int preludeSignatureSlots = 0;
+// The symbol for each prelude declaration, made the first time any thread uses it and published by
+// compare-and-swap, so threads share it without locking. NULL until then.
+atomic<symbolInfo*>* preludeSymbols = NULL;
+// A prelude signature's ID is its index in the image. A thread's own signatures get IDs from LOCAL_SIGNATURE_BASE
+// up in signatureIds, so the two never collide.
+const int LOCAL_SIGNATURE_BASE = 1 << 24;
+
 // A set of keywords.
 unordered_set<string> keywords =
-{"int", "char", "double", "short", "long", "void", "class", "switch", "case", "bool", "float", "string", "return", "break", "if", "else", "while", "for", "true", "false"};
-// A set of operators mostly, with whitespace characters added to assist in scanning.
-unordered_set<char> operators = {'+', '-', '*', '/', '=', '<', '>', '!', '.', '(', ')', '{', '}', ';', '^', '%', ':', ' ', ',', '\n', '\t', '?', '[', ']', '&', '|'};
+{"int", "char", "double", "short", "long", "void", "class", "switch", "case", "bool", "float", "string", "return", "break", "if", "else", "while", "for", "true", "false", "import"};
+// The operator characters mostly, with whitespace characters added to assist in scanning.
+const char OPERATOR_CHARACTERS[] = "+-*/=<>!.(){};^%: ,\n\t\r?[]&|";
+// Whether each character is in OPERATOR_CHARACTERS, built at compile time so the lexer tests a character with
+// one load.
+struct characterSet
+{
+	bool contains[256];
+	constexpr characterSet(const char* characters) : contains()
+	{
+		for (int c = 0; characters[c] != '\0'; c++)
+		{
+			contains[(unsigned char)characters[c]] = true;
+		}
+	}
+};
+constexpr characterSet operators(OPERATOR_CHARACTERS);
 // A set containing all the operators that are 2 characters.
 unordered_set<string> twoCharOps = {"&&", "||", "==", "<=", "!=", "+=", "-=", "*=", "/=", "->", "++", "--", "<<", ">>", "::"};
 // A set containing all of the data types.
 unordered_set<string> types = {"int", "char", "double", "float", "short", "long", "void", "bool", "string"};
 
-// Breaks an input file into a vector of tokens.
-// Preconditions: An empty string vector.
-// Postconditions: The passed vector is filled with the input's tokens.
-void breakTokens(vector<string>*);
+// The data types an expression can have. A pointer type's value is its base type plus POINTER_TYPE,
+// and TYPE_NULL is the type of a pointer with no base type.
+enum valueType {TYPE_ERROR = -1, TYPE_VOID, TYPE_INT, TYPE_CHAR, TYPE_DOUBLE, TYPE_FLOAT, TYPE_SHORT, TYPE_LONG, TYPE_BOOL, TYPE_STRING,
+	POINTER_TYPE, TYPE_NULL = POINTER_TYPE * 2, TYPE_COUNT};
+// The name of each valueType, used to build signature keys and interface argument lists.
+const string typeNames[TYPE_COUNT] =
+{"void", "int", "char", "double", "float", "short", "long", "bool", "string",
+"*void", "*int", "*char", "*double", "*float", "*short", "*long", "*bool", "*string", "*null"};
+// The valueType of each name in typeNames. TYPE_ERROR is returned by the checker once an error has been shown.
+unordered_map<string, int> typeIds;
 
-// Checks the tokens from the passed vector to determine if their are any type errors in the program.
-// Preconditions: The vector is filled with valid Csimple tokens.
-// Postconditions: None.
-void typeCheck(vector<string>);
+// The unary and binary operators, in the order parseExpression resolves them.
+enum unaryOperator {OP_ADDRESS, OP_DEREF, OP_NOT, UNARY_COUNT};
+enum binaryOperator {OP_MULTIPLY, OP_DIVIDE, OP_ADD, OP_SUBTRACT, OP_LESS, OP_GREATER, OP_LESS_EQUAL, OP_GREATER_EQUAL,
+	OP_EQUAL, OP_NOT_EQUAL, OP_AND, OP_OR, BINARY_COUNT};
+const string unaryTokens[UNARY_COUNT] = {"&", "^", "!"};
+const string binaryTokens[BINARY_COUNT] = {"*", "/", "+", "-", "<", ">", "<=", ">=", "==", "!=", "&&", "||"};
 
-// Takes in an expression (composed of tokens) and determines the data type.
-// Returns a string representation of the data type, or "e" if the expression had a type error.
-// Preconditions: The vector is filled with valid Csimple tokens.
-// Postconditions: None.
-string parseExpression(vector<string>);
+// The codes parseExpression stores for grouping and operator tokens. They share a buffer with operand types,
+// so they start after the last valueType. CODE_EDGE pads both ends of the buffer so operators can always look
+// at their neighbours; as an operand it has no type.
+enum expressionCode {CODE_OPEN_PAREN = TYPE_COUNT, CODE_CLOSE_PAREN, CODE_OPEN_BRACKET, CODE_CLOSE_BRACKET, CODE_BAR,
+	CODE_UNARY, CODE_BINARY = CODE_UNARY + UNARY_COUNT, CODE_EDGE = CODE_BINARY + BINARY_COUNT};
+// The expressionCode of each grouping and operator token.
+unordered_map<string, int> expressionCodes;
+// Scratch space expressions are reduced in, reused between statements so checking does not allocate.
+thread_local vector<int> expressionBuffer;
 
-// Determines the type of the passed token.
-// Returns a string representation of the data type.
-// Preconditions: None.
-// Postconditions: None.
-string tokenType(string*);
+// What the lexer carries from one character to the next: the word being built and what kind of word it is.
+struct lexerState
+{
+	string word;
+	int wordStart;
+	bool isString;
+	bool isChar;
+	bool isNumber;
+	char previous;
+	
+	lexerState() : wordStart(0), isString(false), isChar(false), isNumber(false), previous('\0') {}
+};
+// Files at least twice this size are split into chunks of about this size that are lexed at once.
+const int LEX_CHUNK_SIZE = 1 << 20;
 
-// Finds the first token in the passed vector equal to the passed string.
-// Returns the index the token was found at, or -1 if the token was not found.
-// Preconditions: None
-// Postconditions: None
-int findFirst(vector<string>, string);
+// The token buffer is padded with end of file sentinels on both sides, so lookahead and lookbehind never leave it.
+// The trailing padding also holds every terminator a statement scans for, so each scan is guaranteed to stop
+// inside the buffer and only needs to be checked once it has.
+const string EOF_TOKEN = "";
+const int LEADING_PADDING = 4;
+const int TRAILING_PADDING = 11;
+const string trailingPadding[TRAILING_PADDING] =
+{EOF_TOKEN, EOF_TOKEN, EOF_TOKEN, EOF_TOKEN, ")", "]", ";", EOF_TOKEN, EOF_TOKEN, EOF_TOKEN, EOF_TOKEN};
 
-// Determines if the passed function (composed of tokens) is a valid function call.
-// Returns true if it is a valid function call, false otherwise.
-// Preconditions: The vector is filled with valid Csimple tokens.
-// Postconditions: None.
-bool functionCheck(vector<string>);
+// Interface files hold a module's global declarations so other files can import them without checking it again.
+// The layout is the magic number, the version, the 64 bit hash of the module's source, the length and name of
+// the source file, the declaration count, then for each declaration its name length, name, scope, valueType and
+// argument count (-1 for variables) followed by each argument's valueType. An interface whose source no longer
+// has that hash is out of date and is not loaded. Other numbers are 32 bit ints in the machine's byte order.
+const char INTERFACE_MAGIC[4] = {'C', 'S', 'I', 'F'};
+const int INTERFACE_VERSION = 2;
+const string INTERFACE_EXTENSION = ".csi";
 
-// Displays error information when an error is encountered.
-// Preconditions: None.
-// Postconditions: An error message appears in the console.
-void showError(int);
+// A prelude image holds declarations shared by every file, compiled once by --compile-prelude and mapped by
+// --prelude as a scope outside each file's globals. It is read where it is mapped, so every position in it is an
+// offset from its start. The layout is the magic number, then the version, the declaration count, the signature
+// count and the slot counts of the name index and the signature index. Then come, for each declaration (sorted
+// by name), the offset and length of its name, its valueType, its argument count (-1 for variables), the offset
+// of its arguments' valueTypes and its signature (-1 for variables); for each signature the offset and length of
+// its key; the name index; the signature index; the arguments; and the names and keys. Each index is a hash
+// table of a power of two slots holding a record number or -1, found by hashName with linear probing. All
+// numbers are 32 bit ints in the machine's byte order.
+const char PRELUDE_MAGIC[4] = {'C', 'S', 'P', 'L'};
+const int PRELUDE_VERSION = 2;
+const int PRELUDE_RECORD = 6; // the ints in each declaration's record
+const int PRELUDE_SIGNATURE_RECORD = 2; // the ints in each signature's record
+// The scope prelude declarations are in, outside the globals so a file can declare the same names.
+const int PRELUDE_SCOPE = -1;
+
+// Token caches hold a file's tokens so an unchanged file does not need to be lexed again. The layout is the
+// magic number, the version, the 64 bit hash of the source text, the number of distinct token strings, the number
+// of tokens, then each distinct string (its length then its characters), then each token as the index of its
+// string and its offset. Numbers are 32 bit ints in the machine's byte order, except the hash. A cache whose
+// version or hash does not match is ignored and rewritten. The checker works on token strings, so a hit still
+// builds a string for every token; what it saves is the scanning, which is most of lexing.
+const char TOKEN_CACHE_MAGIC[4] = {'C', 'S', 'T', 'K'};
+const int TOKEN_CACHE_VERSION = 1;
+const string TOKEN_CACHE_EXTENSION = ".tokc";
+// Set by --token-cache. Token caches are only read and written when this is on.
+bool useTokenCache = false;
+// Cleared by --blocking-reads, so batches are read with blocking reads on a pool of threads even where io_uring
+// is available.
+bool useIoUring = true;
+// The most files a batch has being read at once.
+const int READ_QUEUE_DEPTH = 64;
+
+// The checker's state at the start of a top-level unit (the start of the file, or just after a top-level }).
+// Checking can be resumed from any checkpoint once the symbol table is rolled back to it.
+struct checkpoint
+{
+	int tokenIndex; // the first token of the unit
+	int declarations; // the size of declarationLog
+	int exports; // the size of exportedNames
+	string function; // currentFunc
+	int argumentsEnd;
+};
+// The checkpoints reached so far in the current file, in order.
+thread_local vector<checkpoint> checkpoints;
 
-int main()
+// Everything kept between checks of a file in watch or server mode. The checker state is swapped in while the
+// file is checked.
+struct watchedFile
 {
+	string fileName;
+	string source;
 	vector<string> tokens;
-	breakTokens(&tokens);
-	typeCheck(tokens);
-	return 0;
-}
+	vector<int> offsets;
+	unordered_map<string, symbolInfo*> symbols;
+	vector<string> declarations;
+	vector<string> exports;
+	vector<checkpoint> checkpoints;
+	// the result of the last check
+	string output;
+	int errorCode; // 0 if the check passed
+	int errorLine; // the error's position, with both starting at 0
+	int errorColumn;
+	int errorLength; // the length of the token the error is on
+};
 
-void breakTokens(vector<string>* tokenList)
+// A text document open in the editor, in server mode.
+struct openDocument
 {
-	ifstream input("test.txt");
-	string word = "";
-	bool isString = false;
-	bool isChar = false;
-	bool isNumber = false;
-	char current;
-	char previous;
+	string uri;
+	string text; // the text as the editor has it, only used by the thread reading messages
+	int version;
+	bool open;
+	chrono::steady_clock::time_point lastChange; // when the text last changed
+	chrono::steady_clock::time_point checkDue; // when the text should next be checked, if checkPending
+	bool checkPending;
+	atomic<bool> cancel; // raised when the text changes while it is being checked
+	watchedFile state; // only used by the checking thread
+};
+
+// A value read from or written as JSON.
+struct jsonValue
+{
+	enum {JSON_NULL, JSON_BOOL, JSON_NUMBER, JSON_STRING, JSON_ARRAY, JSON_OBJECT} kind;
+	bool boolean;
+	double number;
+	string text; // the value of a string, or the unparsed text of a number
+	vector<jsonValue> items; // the items of an array
+	vector<pair<string, jsonValue> > members; // the members of an object
 	
-	while (!input.eof())
+	jsonValue() : kind(JSON_NULL), boolean(false), number(0) {}
+	// Returns the member with the passed name, or a null value if there is none.
+	const jsonValue& get(const string& name) const
 	{
-		current = input.get();
-		if (operators.find(current) == operators.end() || isString || isChar || (isNumber && current == '.')) // current character is not an operator (building word)
+		static const jsonValue missing;
+		for (size_t m = 0; m < members.size(); m++)
 		{
-			word += current;
-			if (current == '\"')
-			{
-				isString = !isString;
-			}
-			else if (current == '\'')
-			{
-				isChar = !isChar;
-			}
-			else if (current > 47 && current < 58) // current is a number (ascii range 48-57)
+			if (members[m].first == name)
 			{
-				isNumber = true;
+				return members[m].second;
 			}
 		}
-		else // if the current char is an operator and the scanner is not currently building a string, char, or number
-		{
-			string op = string(1, current);
-			
-			if (word != "") // add the word that was being built up before the op was reached
+		return missing;
+	}
+};
+
+// How long the server waits after a change before checking, so typing does not start a check per keystroke.
+const int SERVER_DEBOUNCE_MS = 150;
+
+// Set by --profile. Above 0, each file's check is timed and this many of its most expensive top-level functions
+// and expressions are reported with the results.
+int profileTop = 0;
+// Set by --trace. When not empty, a Chrome trace of each file's check is written to this path.
+string tracePath;
+// When the run started, which trace times are measured from.
+chrono::steady_clock::time_point runStarted;
+
+// Counts of the checker's basic operations. Every check keeps them, since each costs one increment.
+struct operationCounts
+{
+	long long reductions; // operators and groups resolved in expressions
+	long long lookups; // names looked up in the symbol table
+	long long calls; // function calls checked
+};
+thread_local operationCounts operationsDone;
+
+// The time and operations spent on one top-level function or one expression.
+struct profileEntry
+{
+	string name; // the function's name, or the source line the expression is on
+	int offset; // where it starts in the source
+	int line;
+	double start; // microseconds after runStarted
+	double duration; // microseconds
+	operationCounts operations;
+};
+
+// Everything profiled about one file's check.
+struct fileProfile
+{
+	string fileName;
+	int thread; // a small number identifying the thread that checked it, for the trace
+	double start;
+	double duration;
+	vector<profileEntry> functions; // in source order
+	vector<profileEntry> expressions; // the slowest ones, kept as a heap until the check ends, then slowest first
+	// the unit of the file being timed
+	int unitToken;
+	string unitFunction;
+	chrono::steady_clock::time_point unitStarted;
+	operationCounts unitOperations;
+	bool unitOpen; // whether the last entry in functions is still being timed
+};
+// The profile of the file this thread is checking, or NULL if checks are not being profiled.
+thread_local fileProfile* currentProfile = NULL;
+// Every file's finished profile, in the order they finished.
+vector<fileProfile*> profiles;
+mutex profilesLock;
+
+// Set by --workers. Above 0, a batch's files are checked in this many worker processes instead of threads, so a
+// file that crashes the checker or never finishes fails on its own instead of taking the batch with it.
+int workerCount = 0;
+// Set by --worker-timeout: how many milliseconds a worker may spend on one file before it is killed.
+int workerTimeout = 10000;
+// The number of results the ring holds at once. At most this many workers are started.
+const int RESULT_SLOTS = 64;
+// Output beyond this many bytes is cut off when a worker publishes it, and the result says how much was lost.
+const int RESULT_TEXT_SIZE = 4096;
+
+// One result in the ring shared with the worker processes.
+struct resultSlot
+{
+	atomic<int> state; // a slotState
+	int owner; // the process ID of the worker writing or that wrote the result
+	int file; // the index of the file in the batch
+	bool passed;
+	int length;
+	int omitted; // the bytes of output that did not fit in text
+	char text[RESULT_TEXT_SIZE]; // the checker's output
+};
+enum slotState {SLOT_FREE, SLOT_WRITING, SLOT_READY};
+
+// The memory shared by the parent and its workers. Workers claim slots in turn; the parent frees each slot once
+// it has copied the result out.
+struct resultRing
+{
+	atomic<unsigned> next; // the number of slots claimed so far
+	resultSlot slots[RESULT_SLOTS];
+};
+
+// A worker process, and the file it was last sent.
+struct workerProcess
+{
+	int pid;
+	int jobs; // the pipe file indices are sent to the worker through
+	int file; // -1 while the worker is waiting for a file
+	chrono::steady_clock::time_point started; // when the worker was sent the file
+};
+
+// The worker processes checking a batch, and what they share.
+struct workerPool
+{
+	resultRing* ring;
+	int notifyRead; // workers write the index of each slot they fill to this pipe
+	int notifyWrite;
+	vector<workerProcess> workers;
+};
+
+// Everything known about one file being checked as part of a batch.
+struct moduleInfo
+{
+	string fileName; // the path the file was given as
+	string name; // the name other files import it by: the file name without its directory or extension
+	string directory; // the directory part of fileName, including the final separator
+	string source; // the file's text, moved into sourceText while it is checked
+	int readError; // the error number of reading the file, or 0 if it was read
+	vector<string> tokens;
+	vector<int> offsets;
+	vector<string> imports; // the names of the modules this file imports
+	vector<int> importOffsets; // where each import statement starts
+	string output; // everything the checker wrote about the file
+	bool passed;
+};
+
+// The typing rule for a unary operator applied to an operand of the passed type.
+// Returns the result's valueType, or the negated error code if the operand is invalid.
+constexpr int unaryRule(int op, int operand)
+{
+	switch (op)
+	{
+		case OP_ADDRESS:
+			return operand == TYPE_INT || operand == TYPE_CHAR ? operand + POINTER_TYPE : -17;
+		case OP_DEREF:
+			return operand == TYPE_INT + POINTER_TYPE || operand == TYPE_CHAR + POINTER_TYPE ? operand - POINTER_TYPE : -18;
+		default: // OP_NOT
+			return operand == TYPE_BOOL ? TYPE_BOOL : -15;
+	}
+}
+
+// The typing rule for a binary operator applied to operands of the passed types.
+// Returns the result's valueType, or the negated error code if the operands are invalid.
+constexpr int binaryRule(int op, int left, int right)
+{
+	bool bothInt = left == TYPE_INT && right == TYPE_INT;
+	bool leftPointer = left >= POINTER_TYPE;
+	bool rightPointer = right >= POINTER_TYPE;
+	switch (op)
+	{
+		case OP_MULTIPLY:
+		case OP_DIVIDE:
+			return bothInt ? TYPE_INT : (leftPointer || rightPointer ? -16 : -15);
+		case OP_ADD:
+			if (leftPointer && right == TYPE_INT)
 			{
-				tokenList->push_back(word);
+				return left;
 			}
-			
-			if (twoCharOps.find(previous + op) != twoCharOps.end())
+			return bothInt ? TYPE_INT : (left == TYPE_INT && rightPointer ? right : -15);
+		case OP_SUBTRACT:
+			return bothInt ? TYPE_INT : (leftPointer && right == TYPE_INT ? left : -15);
+		case OP_LESS:
+		case OP_GREATER:
+		case OP_LESS_EQUAL:
+		case OP_GREATER_EQUAL:
+			return bothInt ? TYPE_BOOL : -15;
+		case OP_EQUAL:
+		case OP_NOT_EQUAL:
+			if (left == right && (left == TYPE_INT || left == TYPE_CHAR || left == TYPE_BOOL))
 			{
-				tokenList->pop_back();
-				tokenList->push_back(previous + op);
+				return TYPE_BOOL;
 			}
-			else 
+			if ((left == TYPE_INT + POINTER_TYPE || left == TYPE_NULL) && (right == TYPE_INT + POINTER_TYPE || right == TYPE_NULL))
 			{
-				if (current != ' ' && current != '\t') // whitespace is not a token
-				{
-					tokenList->push_back(op);
-				}
+				return TYPE_BOOL;
 			}
-			
-			word = "";
-			isString = false;
-			isChar = false;
-			if (current != '.')
+			if ((left == TYPE_CHAR + POINTER_TYPE || left == TYPE_NULL) && (right == TYPE_CHAR + POINTER_TYPE || right == TYPE_NULL))
 			{
-				isNumber = false;
+				return TYPE_BOOL;
 			}
-		}
-		previous = current;
+			return -15;
+		default: // OP_AND, OP_OR
+			return left == TYPE_BOOL && right == TYPE_BOOL ? TYPE_BOOL : -15;
 	}
-	
-	input.close();
 }
 
-void typeCheck(vector<string> tokens)
+// Every typing rule, evaluated at compile time so resolving an operator is a single lookup.
+struct operatorTable
 {
-	string lastValue;
-	for (int i = 0; i < tokens.size(); i++)
+	signed char unary[UNARY_COUNT][TYPE_COUNT];
+	signed char binary[BINARY_COUNT][TYPE_COUNT][TYPE_COUNT];
+	constexpr operatorTable() : unary(), binary()
 	{
-		string current = tokens[i];
-		
-		if (current == "{")
-		{
-			fileScope++;
-		}
-		else if (current == "}")
+		for (int op = 0; op < UNARY_COUNT; op++)
 		{
-			fileScope--;
-		}
-		else if (current == "\n")
-		{
-			lineNo++;
-		}
-		else if (types.find(current) != types.end()) // current token is a data type - line is a declaration
-		{
-			string pointerAdd = "";
-			if (tokens[i + 1] == "*") // pointer
-			{
-				i++;
-				pointerAdd = "*";
-			}
-			string name = tokens[i + 1];
-			unordered_map<string, symbolInfo*>::iterator it = symbolTable.find(name);
-			string next = tokens[i + 2];
-			vector<string> arguments;
-			if (next == "(") // function
+			for (int operand = 0; operand < TYPE_COUNT; operand++)
 			{
-				if (current == "string")
-				{
-					showError(8);
-					return;
-				}
-				
-				if (name == "Main")
-				{
-					if (it != symbolTable.end() || fileScope != 0) // main already exists in symbol table or not currently in global scope
-					{
-						showError(1);
-						return;
-					}
-					else if (tokens[i + 2] == "(" && tokens[i + 3] != ")")
-					{
-						showError(2);
-						return;
-					}
-				}
-				
-				currentFunc = name;
-				if (it != symbolTable.end() && (it->second)->getScope() == fileScope) // duplicate function
-				{
-					showError(3);
-					return;
-				}
-				i += 2; // advancing to the arguments
-				int intoArgs = 0;
-				while (next != ")")
-				{
-					intoArgs++;
-					next = tokens[i + intoArgs];
-					if (types.find(next) != types.end())
-					{
-						arguments.push_back(next);
-					}
-				}
-				symbolInfo* info = new symbolInfo(fileScope, current, arguments);
-				pair<string, symbolInfo*> data(name, info);
-				symbolTable.insert(data);
+				unary[op][operand] = unaryRule(op, operand);
 			}
-			else // identifier
+		}
+		for (int op = 0; op < BINARY_COUNT; op++)
+		{
+			for (int left = 0; left < TYPE_COUNT; left++)
 			{
-				i++;
-				if (it != symbolTable.end() && (it->second)->getScope() == fileScope) // duplicate id
+				for (int right = 0; right < TYPE_COUNT; right++)
 				{
-					showError(4);
-					return;
+					binary[op][left][right] = binaryRule(op, left, right);
 				}
-				symbolInfo* info = new symbolInfo(fileScope, pointerAdd + current);
-				pair<string, symbolInfo*> data(name, info);
-				symbolTable.insert(data);
 			}
 		}
-		else if (tokens[i + 1] == "(" && operators.find(current[0]) == operators.end() && keywords.find(current) == keywords.end()) // function calls
+	}
+};
+constexpr operatorTable operatorRules;
+
+// Fills typeIds and expressionCodes, which every check looks type names and operators up in.
+// Preconditions: The tables are empty.
+// Postconditions: The tables hold every type and every token an expression may contain.
+void setupTables();
+
+// Breaks the named input file into a vector of tokens. Newlines are not tokens; instead each token records
+// the byte offset it starts at in the source text. The tokens come from the file's token cache instead when
+// useTokenCache is on and the cache matches.
+// Preconditions: An empty string vector and an empty int vector.
+// Postconditions: sourceText holds the file. The passed vectors are filled with the input's tokens and their
+// offsets, between the leading and trailing padding.
+void breakTokens(string, vector<string>*, vector<int>*);
+
+// Reads the named file into sourceText.
+// Preconditions: None.
+// Postconditions: sourceText holds the file, and lineStarts is cleared.
+void readSource(string);
+
+// Breaks sourceText into tokens as breakTokens does, using the token cache of the named file.
+// Preconditions: An empty string vector and an empty int vector.
+// Postconditions: The passed vectors are filled with the tokens and their offsets, between the padding.
+void tokenizeSource(string, vector<string>*, vector<int>*);
+
+// Reads the whole named file with one read where possible.
+// Returns 0, or the error number of the call that failed if the file could not be opened or read.
+// Preconditions: None.
+// Postconditions: The passed string holds the file, or is empty if it could not be read.
+int readFile(const string&, string*);
+
+// Reads the named files, keeping up to READ_QUEUE_DEPTH of them being read at once. Uses io_uring where the
+// system supports it, and blocking reads spread over a pool of threads otherwise.
+// Preconditions: None.
+// Postconditions: The passed function has been called once for each file, with its index, its text and the error
+// number readFile would return for it, as soon as that file was read. It may be called from several threads at
+// once, and may take the text.
+void readFiles(const vector<string>&, const function<void(int, string*, int)>&);
+
+// Reads the named files through io_uring, as readFiles does. A file the kernel cannot open or stat this way, or
+// that ends before its size said it would, is read with readFile instead. A read that fails gives the file's error.
+// Returns false, without reading anything, if io_uring is not available or the kernel does not support its
+// openat, statx and read operations.
+// Preconditions: None.
+// Postconditions: The passed function has been called for each file, from this thread only.
+bool readFilesUring(const vector<string>&, const function<void(int, string*, int)>&);
+
+// Breaks sourceText into tokens, as described for breakTokens, starting at the first offset. If the second offset
+// is not -1, lexing stops after the first ;, { or } token at or past it.
+// Returns the offset lexing stopped at, or -1 if it reached the end of the text.
+// Preconditions: The first offset is 0 or just after a ;, { or } token.
+// Postconditions: The input's tokens and their offsets are added to the passed vectors.
+int lexSource(vector<string>*, vector<int>*, int, int);
+
+// Lexes the passed text from the first offset up to the second, continuing from the passed state, with
+// lexSource's rule for stopping after the third offset. A word still being built at the end is left in the state.
+// Returns the offset lexing stopped at, or -1 if it reached the second offset.
+// Preconditions: None.
+// Postconditions: The tokens and their offsets are added to the passed vectors, and the state is updated.
+int lexRange(const string&, vector<string>*, vector<int>*, lexerState*, int, int, int);
+
+// Breaks sourceText into tokens as lexSource does from the start, splitting it at newlines into the passed number
+// of chunks that are lexed at once. Each chunk is lexed as if nothing carried over into it, then lexed again in
+// order if the chunk before it ended inside a string or char literal.
+// Preconditions: None.
+// Postconditions: The tokens and their offsets are added to the passed vectors, exactly as lexSource adds them.
+void lexChunks(vector<string>*, vector<int>*, int);
+
+// Updates the tokens of a file whose text changed from the passed text to sourceText. Only the statements
+// around the change are lexed again; the tokens after them are kept and have their offsets moved.
+// Returns the index of the first token that may have changed, or -1 if the text is the same.
+// Preconditions: The vectors hold the old text's tokens, including the padding.
+// Postconditions: The vectors hold sourceText's tokens.
+int relexChanges(const string&, vector<string>*, vector<int>*);
+
+// Computes the 64 bit FNV-1a hash of sourceText.
+// Preconditions: None.
+// Postconditions: None.
+unsigned long long hashSource();
+
+// Writes the tokens in the passed vectors from the first index on to a token cache at the passed path.
+// Preconditions: The tokens are sourceText's, and the hash is hashSource's.
+// Postconditions: None.
+void writeTokenCache(string, unsigned long long, const vector<string>&, const vector<int>&, int);
+
+// Reads the token cache at the passed path if its version and source hash match.
+// Returns true if the cache was used.
+// Preconditions: None.
+// Postconditions: If the cache was used, its tokens and offsets are added to the passed vectors.
+bool loadTokenCache(string, unsigned long long, vector<string>*, vector<int>*);
+
+// Checks the tokens from the passed vector, starting at the passed index, to determine if their are any type
+// errors in the program.
+// Returns true if no errors were found.
+// Preconditions: The vector is filled by breakTokens, and the offsets vector matches it. The index is
+// LEADING_PADDING, or the token index of a checkpoint the checker has been restored to.
+// Postconditions: checkpoints holds a checkpoint for each top-level unit that was reached.
+bool typeCheck(const vector<string>&, const vector<int>&, int);
+
+// Takes in an expression (the tokens from the first index up to the second) and determines the data type.
+// The last argument is the byte offset the expression starts at, where a profile records it.
+// Returns the valueType of the expression, or TYPE_ERROR if the expression had a type error.
+// Preconditions: The range is filled with valid Csimple tokens.
+// Postconditions: expressionBuffer is overwritten.
+int parseExpression(const vector<string>&, int, int, int);
+
+// Reduces the part of expressionBuffer from the first index up to the index the pointer holds to a single operand.
+// Returns the valueType of that part, or TYPE_ERROR if it had a type error.
+// Preconditions: The range holds operand types and expression codes.
+// Postconditions: The range is replaced by its type, and the end index is updated to match.
+int reduceExpression(int, int*);
+
+// Reduces the group opened at the first index and closed at the second (or the end index if it was never closed),
+// then removes everything but the opening element.
+// Returns the valueType of the group's contents, or TYPE_ERROR if they had a type error.
+// Preconditions: Both indexes are within the range being reduced.
+// Postconditions: The end index is updated to match the removed elements.
+int reduceGroup(int, int, int*);
+
+// Determines the type of an element of expressionBuffer used as an operand.
+// Returns the element itself if it is a valueType, otherwise the type tokenType gives the matching token.
+// Preconditions: None.
+// Postconditions: None.
+int operandType(int);
+
+// Determines the type of the passed token.
+// Returns the valueType of the token.
+// Preconditions: None.
+// Postconditions: None.
+int tokenType(const string*);
+
+// Adds the passed return type and argument types to signatureIds if they are not already in it or in the
+// prelude image.
+// Returns the signature's ID.
+// Preconditions: None.
+// Postconditions: signatureKey holds the signature's key.
+int internSignature(const string&, vector<string>*);
+
+// Finds the ID of a signature key in the prelude image, or else in signatureIds.
+// Returns the ID, or -1 if the signature has not been interned.
+// Preconditions: None.
+// Postconditions: None.
+int findSignature(const string&);
+
+// Computes the 64 bit FNV-1a hash of the passed bytes.
+// Preconditions: None.
+// Postconditions: None.
+unsigned long long hashName(const char*, size_t);
+
+// Converts a type name to its valueType.
+// Preconditions: None.
+// Postconditions: None.
+int typeIndex(const string&);
+
+// Finds the first element of the passed vector between the two indexes that is equal to the passed value.
+// Returns the index the value was found at, or -1 if the value was not found.
+// Preconditions: None
+// Postconditions: None
+int findFirst(const vector<int>*, int, int, int);
+
+// Finds the element closing the group opened at the first index, skipping over nested groups of the same kind.
+// Returns the index of the closing element, or the end index if the group is never closed.
+// Preconditions: None
+// Postconditions: None
+int findClose(const vector<int>*, int, int);
+
+// Determines if the function call starting at the passed index is a valid function call.
+// Returns true if it is a valid function call, false otherwise.
+// Preconditions: The tokens from the index on hold the function name, its arguments, and the closing ).
+// Postconditions: None.
+bool functionCheck(const vector<string>&, int);
+
+// Converts a byte offset in the source text to a line and column (both starting at 1).
+// The line index is built on first use with a memchr scan, then searched with binary search.
+// Preconditions: None.
+// Postconditions: The line and column are stored in the passed ints.
+void findLocation(int, int*, int*);
+
+// Checks every passed file. Files are lexed in parallel, then checked in parallel in waves so each file is
+// only checked once every file in the batch it imports has passed and written its interface.
+// Returns true if every file passed.
+// Preconditions: None.
+// Postconditions: The result for each file is printed in the order the files were passed.
+bool checkModules(const vector<string>&);
+
+// Checks one lexed file of a batch on this thread.
+// Preconditions: The file's tokens have been read.
+// Postconditions: The file's output and result are stored, and its interface is written if it passed or
+// removed if it failed.
+void checkModule(moduleInfo*);
+
+// Starts workerCount worker processes that check files of the passed batch.
+// Returns false if the pool could not be set up, in which case the batch is checked on threads instead.
+// Preconditions: Every file of the batch has been lexed, and no other thread is running.
+// Postconditions: None.
+bool startWorkers(workerPool*, vector<moduleInfo>*);
+
+// Starts the worker process for the passed slot of the pool. The new process shares the parent's memory as it
+// was when forked, so it already holds every file's tokens.
+// Returns false if the process could not be started.
+// Preconditions: None.
+// Postconditions: None.
+bool startWorker(workerPool*, int, vector<moduleInfo>*);
+
+// The loop a worker process runs: it checks each file index sent to it and publishes the result in the ring.
+// Preconditions: None.
+// Postconditions: The process exits once the pool closes its job pipe.
+void runWorker(workerPool*, int, vector<moduleInfo>*);
+
+// Checks the files with the passed indices in the pool's worker processes. A worker that crashes or takes longer
+// than workerTimeout milliseconds is replaced, and its file fails.
+// Preconditions: startWorkers succeeded.
+// Postconditions: Each file's output and result are stored.
+void checkInWorkers(workerPool*, const vector<int>&, vector<moduleInfo>*);
+
+// Stops the pool's worker processes and releases the ring.
+// Preconditions: startWorkers succeeded.
+// Postconditions: None.
+void stopWorkers(workerPool*);
+
+// Runs the passed function once for each index below the passed count, spread over a pool of threads.
+// Preconditions: None.
+// Postconditions: None.
+void runParallel(int, const function<void(int)>&);
+
+// Finds how many hardware threads the work on this thread may use.
+// Returns the thread's share, which is at least 1.
+// Preconditions: None.
+// Postconditions: None.
+int availableThreads();
+
+// Clears the symbol table and everything else left over from checking a previous file on this thread.
+// Interned signatures are kept, since symbols kept elsewhere (such as watched files) may still use their IDs.
+// Preconditions: None.
+// Postconditions: None.
+void resetChecker();
+
+// Rolls the checker back to the passed checkpoint.
+// Preconditions: The checkpoint was reached while checking the current file.
+// Postconditions: Symbols declared after the checkpoint are removed.
+void restoreCheckpoint(const checkpoint&);
+
+// Checks the passed files, then checks them again each time they change until the program is stopped.
+// Directories are watched for changes to any .cs file in them.
+// Returns 1 if watching is not possible.
+// Preconditions: None.
+// Postconditions: None.
+int watchFiles(const vector<string>&);
+
+// Checks a watched file. When the second argument is false, only the changes since the last check are lexed
+// and checking resumes from the last top-level unit before the first change.
+// Preconditions: None.
+// Postconditions: The result and how long it took are printed.
+void checkWatchedFile(watchedFile*, bool);
+
+// Checks the passed text as the new contents of a watched file, the same way checkWatchedFile does.
+// Returns false if the text has not changed since the last check, or the check was cancelled.
+// Preconditions: None.
+// Postconditions: The passed string is emptied. The file holds the text and the result of the check.
+bool checkFileText(watchedFile*, string*, bool);
+
+// Prints how many allocations each phase made, how many bytes they took, and the most bytes each phase and the
+// whole run had allocated at once. Does nothing unless the checker was built with -DTRACK_ALLOCATIONS.
+// Preconditions: None.
+// Postconditions: None.
+void reportAllocations();
+
+// Starts profiling the check of the named file on this thread, if profiling is on.
+// Preconditions: sourceText holds the file.
+// Postconditions: None.
+void beginProfile(const string&);
+
+// Finishes profiling the file this thread is checking, and works out the lines of what it recorded.
+// Preconditions: sourceText still holds the file.
+// Postconditions: The profile is added to profiles.
+void endProfile();
+
+// Starts timing a top-level unit of the file being profiled, beginning at the passed token.
+// Preconditions: None.
+// Postconditions: None.
+void beginUnit(int, int);
+
+// Records the time and operations of the unit being timed as an entry for the function it declared.
+// Preconditions: None.
+// Postconditions: None.
+void endUnit(int);
+
+// Prints each profiled file's most expensive top-level functions and expressions, and writes the trace.
+// Preconditions: None.
+// Postconditions: None.
+void reportProfiles();
+
+// Writes a Chrome trace event.
+// Returns the event as JSON.
+// Preconditions: None.
+// Postconditions: None.
+string traceEvent(const string&, const char*, int, double, double, const operationCounts&);
+
+// Adds the sentinel tokens that start the token buffer, or end it if the flag is true.
+// Preconditions: None.
+// Postconditions: None.
+void addPadding(vector<string>*, vector<int>*, bool);
+
+// Runs a Language Server Protocol server on standard input and output, publishing each open document's
+// errors as it is edited. Checks run on a second thread once edits have paused for SERVER_DEBOUNCE_MS, and a
+// check is abandoned if the document changes again before it finishes. Positions are counted in bytes if the
+// client offers the utf-8 position encoding, and otherwise in UTF-16 code units as the protocol's default.
+// Returns 0 once the client asks the server to exit after shutting it down, or 1 if it exits without a shutdown.
+// Preconditions: None.
+// Postconditions: None.
+int runServer();
+
+// Reads one message from standard input, waiting at most the passed number of milliseconds (-1 for no limit).
+// Returns 1 if a message was read, 0 if the time ran out, and -1 if the input was closed.
+// Preconditions: None.
+// Postconditions: The body of the message is stored in the passed string.
+int readMessage(string*, int);
+
+// Writes a message with the passed body to standard output. Safe to call from any thread.
+// Preconditions: None.
+// Postconditions: None.
+void sendMessage(const string&);
+
+// Publishes the result of a document's last check as its diagnostics, with UTF-16 positions if the last
+// argument is true.
+// Preconditions: None.
+// Postconditions: None.
+void publishDiagnostics(openDocument*, int, double, bool);
+
+// Applies one entry of a didChange notification's contentChanges to the passed text, reading its positions as
+// UTF-16 if the last argument is true.
+// Preconditions: None.
+// Postconditions: None.
+void applyChange(string*, const jsonValue&, bool);
+
+// Converts between a position's character, counted in UTF-16 code units, and the byte column it falls on in
+// the line of the passed text starting at the passed offset. Converts to bytes if the last argument is true.
+// Returns the converted column.
+// Preconditions: The offset is the start of a line.
+// Postconditions: None.
+size_t convertColumn(const string&, size_t, size_t, bool);
+
+// Parses the JSON value starting at the passed position.
+// Returns true if the value was valid.
+// Preconditions: None.
+// Postconditions: The value is stored in the passed jsonValue, and the position is moved past it.
+bool parseJson(const string&, size_t*, jsonValue*);
+
+// Writes the passed string as a quoted JSON string.
+// Returns the JSON text.
+// Preconditions: None.
+// Postconditions: None.
+string jsonString(const string&);
+
+// Writes a string or number read by parseJson back as JSON, such as a request ID.
+// Returns the JSON text.
+// Preconditions: None.
+// Postconditions: None.
+string jsonId(const jsonValue&);
+
+// Finds the directory of the file named by a file:// URI, decoding any percent escapes in it.
+// Returns the directory with a trailing slash, or an empty string if the URI does not name a file in one.
+// Preconditions: None.
+// Postconditions: None.
+string uriDirectory(const string&);
+
+// Swaps the checker's state with the state kept for the passed watched file.
+// Preconditions: None.
+// Postconditions: None.
+void swapFileState(watchedFile*);
+
+// Writes the declarations in exportedNames to the interface file at the passed path, recording the passed
+// source file name (without its directory) and sourceText's hash.
+// Preconditions: The file has been checked without errors.
+// Postconditions: None.
+void writeInterface(string, string);
+
+// Adds the declarations in the interface file at the passed path to the symbol table.
+// Returns 0 if it was loaded, otherwise the code of the error that occurred. An interface whose source file,
+// in the interface's directory, is missing or has changed since it was written is not loaded.
+// Preconditions: None.
+// Postconditions: None.
+int loadInterface(string);
+
+// Finds a name in this thread's symbol table, or else in the prelude image.
+// Returns the name's symbol, or NULL if it is not declared.
+// Preconditions: None.
+// Postconditions: None.
+symbolInfo* findSymbol(const string&);
+
+// Finds a key in one of the prelude image's hash indexes, with the passed slot count, over the passed records of
+// the passed number of ints that each start with a key's offset and length.
+// Returns the number of the record holding the key, or -1 if the image does not hold it.
+// Preconditions: A prelude image has been loaded.
+// Postconditions: None.
+int findPreludeEntry(const string&, const int*, int, const int*, int);
+
+// Writes the declarations in exportedNames to a prelude image at the passed path.
+// Returns true if the image was written.
+// Preconditions: The prelude file has been checked without errors.
+// Postconditions: None.
+bool writePrelude(string);
+
+// Maps the prelude image at the passed path and checks that it is well formed. Nothing is copied out of it.
+// Returns true if the image was loaded.
+// Preconditions: No prelude has been loaded, and no file is being checked.
+// Postconditions: findSymbol and findSignature find the image's declarations and signatures. The image stays
+// mapped until the process exits.
+bool loadPrelude(string);
+
+// Maps the whole file at the passed path into memory, read only.
+// Returns the start of the file, or NULL if it could not be opened. An empty file is not mapped.
+// Preconditions: None.
+// Postconditions: The file's size is stored in the passed variable.
+const char* mapFile(string, size_t*);
+
+// Releases a file mapped by mapFile.
+// Preconditions: The pointer and size came from mapFile.
+// Postconditions: None.
+void unmapFile(const char*, size_t);
+
+// Displays error information when an error is encountered.
+// Preconditions: None.
+// Postconditions: An error message is written to diagnostics, and lastError holds the code.
+void showError(int);
+
+// Describes the error with the passed code.
+// Returns the error's message.
+// Preconditions: None.
+// Postconditions: None.
+const char* errorMessage(int);
+
+int main(int argc, char* argv[])
+{
+	setupTables();
+	runStarted = chrono::steady_clock::now();
+	vector<string> fileNames;
+	bool watch = false;
+	string preludeSource;
+	string preludeOutput;
+	for (int a = 1; a < argc; a++)
+	{
+		string argument = argv[a];
+		if (argument == "--token-cache")
+		{
+			useTokenCache = true;
+		}
+		else if (argument == "--lsp")
+		{
+			return runServer();
+		}
+		else if (argument == "--blocking-reads")
+		{
+			useIoUring = false;
+		}
+		else if (argument == "--profile" || argument.compare(0, 10, "--profile=") == 0)
+		{
+			profileTop = argument.size() > 10 ? max(atoi(argument.c_str() + 10), 1) : 10;
+		}
+		else if (argument == "--trace" && a + 1 < argc)
+		{
+			tracePath = argv[++a];
+			profileTop = profileTop == 0 ? 10 : profileTop;
+		}
+		else if (argument == "--workers" && a + 1 < argc)
+		{
+			workerCount = min(max(atoi(argv[++a]), 0), RESULT_SLOTS);
+		}
+		else if (argument == "--worker-timeout" && a + 1 < argc)
+		{
+			workerTimeout = max(atoi(argv[++a]), 1);
+		}
+		else if (argument == "--prelude" && a + 1 < argc)
+		{
+			if (!loadPrelude(argv[++a]))
+			{
+				cout << "The prelude image " << argv[a] << " could not be loaded." << endl;
+				return 1;
+			}
+		}
+		else if (argument == "--compile-prelude" && a + 2 < argc)
+		{
+			preludeSource = argv[++a];
+			preludeOutput = argv[++a];
+		}
+		else if (argument == "--watch")
+		{
+			watch = true;
+		}
+		else
+		{
+			fileNames.push_back(argument);
+		}
+	}
+	
+	if (preludeSource != "")
+	{
+		vector<string> tokens;
+		vector<int> offsets;
+		breakTokens(preludeSource, &tokens, &offsets);
+		ostringstream output;
+		diagnostics = &output;
+		bool passed = typeCheck(tokens, offsets, LEADING_PADDING);
+		diagnostics = &cout;
+		if (!passed)
+		{
+			cout << preludeSource << ": " << output.str() << endl;
+			return 1;
+		}
+		if (!writePrelude(preludeOutput))
+		{
+			cout << "The prelude image " << preludeOutput << " could not be written." << endl;
+			return 1;
+		}
+		cout << "Compiled " << exportedNames.size() << " declarations into " << preludeOutput << "." << endl;
+		return 0;
+	}
+	if (watch)
+	{
+		return watchFiles(fileNames.empty() ? vector<string>(1, "test.txt") : fileNames);
+	}
+	if (!fileNames.empty()) // every other argument is a file to check
+	{
+		int result = checkModules(fileNames) ? 0 : 1;
+		reportProfiles();
+		reportAllocations();
+		return result;
+	}
+	
+	vector<string> tokens;
+	vector<int> offsets;
+	breakTokens("test.txt", &tokens, &offsets);
+	beginProfile("test.txt");
+	typeCheck(tokens, offsets, LEADING_PADDING);
+	endProfile();
+	reportProfiles();
+	reportAllocations();
+	return 0;
+}
+
+void setupTables()
+{
+	for (int i = 0; i < TYPE_COUNT; i++)
+	{
+		typeIds.insert(pair<string, int>(typeNames[i], i));
+	}
+	expressionCodes.insert(pair<string, int>("(", CODE_OPEN_PAREN));
+	expressionCodes.insert(pair<string, int>(")", CODE_CLOSE_PAREN));
+	expressionCodes.insert(pair<string, int>("[", CODE_OPEN_BRACKET));
+	expressionCodes.insert(pair<string, int>("]", CODE_CLOSE_BRACKET));
+	expressionCodes.insert(pair<string, int>("|", CODE_BAR));
+	for (int op = 0; op < UNARY_COUNT; op++)
+	{
+		expressionCodes.insert(pair<string, int>(unaryTokens[op], CODE_UNARY + op));
+	}
+	for (int op = 0; op < BINARY_COUNT; op++)
+	{
+		expressionCodes.insert(pair<string, int>(binaryTokens[op], CODE_BINARY + op));
+	}
+}
+
+void breakTokens(string fileName, vector<string>* tokenList, vector<int>* offsetList)
+{
+	readSource(fileName);
+	tokenizeSource(fileName, tokenList, offsetList);
+}
+
+void tokenizeSource(string fileName, vector<string>* tokenList, vector<int>* offsetList)
+{
+	phaseScope phase(PHASE_LEXING);
+	addPadding(tokenList, offsetList, false);
+	
+	unsigned long long hash = 0;
+	string cacheName = fileName + TOKEN_CACHE_EXTENSION;
+	if (useTokenCache)
+	{
+		hash = hashSource();
+	}
+	if (!useTokenCache || !loadTokenCache(cacheName, hash, tokenList, offsetList))
+	{
+		int chunkCount = min<int>(sourceText.size() / LEX_CHUNK_SIZE, availableThreads());
+		if (chunkCount > 1) // a batch of fewer files than threads leaves each file a share to lex it in chunks
+		{
+			lexChunks(tokenList, offsetList, chunkCount);
+		}
+		else
+		{
+			lexSource(tokenList, offsetList, 0, -1);
+		}
+		if (useTokenCache)
+		{
+			writeTokenCache(cacheName, hash, *tokenList, *offsetList, LEADING_PADDING);
+		}
+	}
+	addPadding(tokenList, offsetList, true);
+}
+
+void addPadding(vector<string>* tokenList, vector<int>* offsetList, bool trailing)
+{
+	if (trailing)
+	{
+		for (int i = 0; i < TRAILING_PADDING; i++)
+		{
+			tokenList->push_back(trailingPadding[i]);
+			offsetList->push_back(sourceText.size());
+		}
+	}
+	else
+	{
+		for (int i = 0; i < LEADING_PADDING; i++)
+		{
+			tokenList->push_back(EOF_TOKEN);
+			offsetList->push_back(0);
+		}
+	}
+}
+
+void readSource(string fileName)
+{
+	readFile(fileName, &sourceText);
+	lineStarts.clear();
+}
+
+int readFile(const string& fileName, string* text)
+{
+#ifndef _WIN32
+	text->clear();
+	int file = open(fileName.c_str(), O_RDONLY | O_CLOEXEC);
+	if (file == -1)
+	{
+		return errno;
+	}
+	struct stat info;
+	size_t size = fstat(file, &info) == 0 && S_ISREG(info.st_mode) ? info.st_size : 0;
+	text->resize(size);
+	size_t done = 0;
+	while (true)
+	{
+		if (done == text->size()) // the file may have grown since fstat, or not be a regular file
+		{
+			text->resize(max<size_t>(done * 2, 4096));
+		}
+		ssize_t length = read(file, &(*text)[done], text->size() - done);
+		if (length == -1 && errno == EINTR)
+		{
+			continue;
+		}
+		if (length == -1) // such as a directory, which opens but cannot be read
+		{
+			int error = errno;
+			text->clear();
+			close(file);
+			return error;
+		}
+		if (length == 0)
+		{
+			break;
+		}
+		done += length;
+	}
+	text->resize(done);
+	close(file);
+	return 0;
+#else
+	ifstream input(fileName.c_str(), ios::binary);
+	if (!input)
+	{
+		text->clear();
+		return ENOENT;
+	}
+	text->assign(istreambuf_iterator<char>(input), istreambuf_iterator<char>());
+	input.close();
+	return 0;
+#endif
+}
+
+int lexSource(vector<string>* tokenList, vector<int>* offsetList, int start, int stopAfter)
+{
+	lexerState state;
+	state.previous = start > 0 ? sourceText[start - 1] : '\0';
+	int stoppedAt = lexRange(sourceText, tokenList, offsetList, &state, start, sourceText.size(), stopAfter);
+	if (stoppedAt == -1 && state.word != "") // input ended in the middle of a word
+	{
+		tokenList->push_back(state.word);
+		offsetList->push_back(state.wordStart);
+	}
+	return stoppedAt;
+}
+
+int lexRange(const string& text, vector<string>* tokenList, vector<int>* offsetList, lexerState* state, int start, int end, int stopAfter)
+{
+	string& word = state->word;
+	int& wordStart = state->wordStart;
+	bool& isString = state->isString;
+	bool& isChar = state->isChar;
+	bool& isNumber = state->isNumber;
+	char& previous = state->previous;
+	char current;
+	
+	for (int i = start; i < end; i++)
+	{
+		current = text[i];
+		if (!operators.contains[(unsigned char)current] || isString || isChar || (isNumber && current == '.')) // current character is not an operator (building word)
+		{
+			if (word == "")
+			{
+				wordStart = i;
+			}
+			word += current;
+			if (current == '\"')
+			{
+				isString = !isString;
+			}
+			else if (current == '\'')
+			{
+				isChar = !isChar;
+			}
+			else if (current > 47 && current < 58) // current is a number (ascii range 48-57)
+			{
+				isNumber = true;
+			}
+		}
+		else // if the current char is an operator and the scanner is not currently building a string, char, or number
+		{
+			string op = string(1, current);
+			
+			if (word != "") // add the word that was being built up before the op was reached
+			{
+				tokenList->push_back(word);
+				offsetList->push_back(wordStart);
+			}
+			
+			if (twoCharOps.find(previous + op) != twoCharOps.end())
+			{
+				tokenList->pop_back();
+				offsetList->pop_back();
+				tokenList->push_back(previous + op);
+				offsetList->push_back(i - 1);
+			}
+			else 
+			{
+				if (current != ' ' && current != '\t' && current != '\n' && current != '\r') // whitespace is not a token
+				{
+					tokenList->push_back(op);
+					offsetList->push_back(i);
+				}
+				if (stopAfter != -1 && i >= stopAfter && (current == ';' || current == '{' || current == '}'))
+				{
+					previous = current;
+					word = "";
+					return i + 1; // nothing carries over from before a statement boundary
+				}
+			}
+			
+			word = "";
+			isString = false;
+			isChar = false;
+			if (current != '.')
+			{
+				isNumber = false;
+			}
+		}
+		previous = current;
+	}
+	return -1;
+}
+
+void lexChunks(vector<string>* tokenList, vector<int>* offsetList, int chunkCount)
+{
+	// each chunk ends just after a newline, so no token or two character operator spans two chunks unless it is
+	// inside a literal, which is the only state a newline does not reset
+	vector<int> bounds(1, 0);
+	for (int c = 1; c < chunkCount; c++)
+	{
+		size_t split = sourceText.find('\n', max<size_t>((size_t)sourceText.size() * c / chunkCount, bounds.back()));
+		if (split == string::npos)
+		{
+			break;
+		}
+		if (split + 1 > (size_t)bounds.back())
+		{
+			bounds.push_back(split + 1);
+		}
+	}
+	bounds.push_back(sourceText.size());
+	chunkCount = bounds.size() - 1;
+	
+	struct lexedChunk
+	{
+		vector<string> tokens;
+		vector<int> offsets;
+		lexerState state; // the state at the end of the chunk
+	};
+	vector<lexedChunk> chunks(chunkCount);
+	const string& text = sourceText; // sourceText belongs to this thread, so the other threads are given the text
+	runParallel(chunkCount, [&](int c)
+	{
+		lexedChunk& chunk = chunks[c];
+		chunk.state.previous = c > 0 ? '\n' : '\0';
+		lexRange(text, &chunk.tokens, &chunk.offsets, &chunk.state, bounds[c], bounds[c + 1], -1);
+	});
+	
+	// a chunk whose guess was wrong is lexed again from where the chunk before it really ended
+	size_t total = 0;
+	for (int c = 1; c < chunkCount; c++)
+	{
+		if (chunks[c - 1].state.word != "")
+		{
+			lexedChunk& chunk = chunks[c];
+			chunk.tokens.clear();
+			chunk.offsets.clear();
+			chunk.state = chunks[c - 1].state;
+			lexRange(sourceText, &chunk.tokens, &chunk.offsets, &chunk.state, bounds[c], bounds[c + 1], -1);
+		}
+	}
+	for (int c = 0; c < chunkCount; c++)
+	{
+		total += chunks[c].tokens.size();
+	}
+	
+	tokenList->reserve(tokenList->size() + total + TRAILING_PADDING + 1);
+	offsetList->reserve(offsetList->size() + total + TRAILING_PADDING + 1);
+	for (int c = 0; c < chunkCount; c++)
+	{
+		for (size_t t = 0; t < chunks[c].tokens.size(); t++)
+		{
+			tokenList->push_back(move(chunks[c].tokens[t]));
+		}
+		offsetList->insert(offsetList->end(), chunks[c].offsets.begin(), chunks[c].offsets.end());
+	}
+	const lexerState& last = chunks.back().state;
+	if (last.word != "") // input ended in the middle of a word
+	{
+		tokenList->push_back(last.word);
+		offsetList->push_back(last.wordStart);
+	}
+}
+
+int relexChanges(const string& oldText, vector<string>* tokens, vector<int>* offsets)
+{
+	phaseScope phase(PHASE_LEXING);
+	int oldSize = oldText.size();
+	int newSize = sourceText.size();
+	int prefix = 0;
+	while (prefix < oldSize && prefix < newSize && oldText[prefix] == sourceText[prefix])
+	{
+		prefix++;
+	}
+	if (prefix == oldSize && prefix == newSize)
+	{
+		return -1;
+	}
+	int suffix = 0;
+	while (suffix < oldSize - prefix && suffix < newSize - prefix
+	&& oldText[oldSize - 1 - suffix] == sourceText[newSize - 1 - suffix])
+	{
+		suffix++;
+	}
+	int shift = newSize - oldSize;
+	
+	// start lexing just after the last statement boundary before the change
+	int end = tokens->size() - TRAILING_PADDING;
+	int first = lower_bound(offsets->begin() + LEADING_PADDING, offsets->begin() + end, prefix) - offsets->begin();
+	int lexStart = 0;
+	while (first > LEADING_PADDING)
+	{
+		const string& token = (*tokens)[first - 1];
+		if (token == ";" || token == "{" || token == "}")
+		{
+			lexStart = (*offsets)[first - 1] + 1;
+			break;
+		}
+		first--;
+	}
+	
+	// lex until a statement boundary inside the unchanged suffix lines up with the same boundary in the old tokens
+	vector<string> freshTokens;
+	vector<int> freshOffsets;
+	int rest = end; // the first old token kept after the new ones
+	int position = lexStart;
+	while (position != -1)
+	{
+		position = lexSource(&freshTokens, &freshOffsets, position, newSize - suffix);
+		if (position != -1)
+		{
+			int oldOffset = freshOffsets.back() - shift;
+			int match = lower_bound(offsets->begin() + first, offsets->begin() + end, oldOffset) - offsets->begin();
+			if (match < end && (*offsets)[match] == oldOffset && (*tokens)[match] == freshTokens.back())
+			{
+				rest = match + 1;
+				break;
+			}
+		}
+	}
+	
+	for (size_t i = rest; i < tokens->size(); i++)
+	{
+		(*offsets)[i] += shift;
+	}
+	for (size_t i = end; i < tokens->size(); i++) // the padding points at the end of the file
+	{
+		(*offsets)[i] = newSize;
+	}
+	tokens->erase(tokens->begin() + first, tokens->begin() + rest);
+	offsets->erase(offsets->begin() + first, offsets->begin() + rest);
+	tokens->insert(tokens->begin() + first, freshTokens.begin(), freshTokens.end());
+	offsets->insert(offsets->begin() + first, freshOffsets.begin(), freshOffsets.end());
+	return first;
+}
+
+unsigned long long hashSource()
+{
+	return hashName(sourceText.data(), sourceText.size());
+}
+
+unsigned long long hashName(const char* bytes, size_t size)
+{
+	unsigned long long hash = 14695981039346656037ULL;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= (unsigned char)bytes[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+void writeTokenCache(string path, unsigned long long hash, const vector<string>& tokens, const vector<int>& offsets, int first)
+{
+	unordered_map<string, int> stringIds;
+	vector<const string*> strings;
+	vector<int> records;
+	for (size_t i = first; i < tokens.size(); i++)
+	{
+		unordered_map<string, int>::iterator it = stringIds.find(tokens[i]);
+		if (it == stringIds.end())
+		{
+			it = stringIds.insert(pair<string, int>(tokens[i], strings.size())).first;
+			strings.push_back(&tokens[i]);
+		}
+		records.push_back(it->second);
+		records.push_back(offsets[i]);
+	}
+	
+	ofstream output(path.c_str(), ios::binary);
+	output.write(TOKEN_CACHE_MAGIC, sizeof(TOKEN_CACHE_MAGIC));
+	output.write((const char*)&TOKEN_CACHE_VERSION, sizeof(int));
+	output.write((const char*)&hash, sizeof(hash));
+	int counts[2] = {(int)strings.size(), (int)(tokens.size() - first)};
+	output.write((const char*)counts, sizeof(counts));
+	for (size_t s = 0; s < strings.size(); s++)
+	{
+		int length = strings[s]->size();
+		output.write((const char*)&length, sizeof(int));
+		output.write(strings[s]->data(), length);
+	}
+	output.write((const char*)records.data(), records.size() * sizeof(int));
+}
+
+bool loadTokenCache(string path, unsigned long long hash, vector<string>* tokenList, vector<int>* offsetList)
+{
+	size_t size;
+	const char* file = mapFile(path, &size);
+	if (file == NULL)
+	{
+		return false;
+	}
+	
+	// the header is checked before anything is read from the rest of the file
+	const int headerSize = sizeof(TOKEN_CACHE_MAGIC) + sizeof(int) + sizeof(hash) + 2 * sizeof(int);
+	int version;
+	unsigned long long storedHash;
+	int counts[2];
+	bool valid = size >= headerSize && memcmp(file, TOKEN_CACHE_MAGIC, sizeof(TOKEN_CACHE_MAGIC)) == 0;
+	if (valid)
+	{
+		memcpy(&version, file + sizeof(TOKEN_CACHE_MAGIC), sizeof(int));
+		memcpy(&storedHash, file + sizeof(TOKEN_CACHE_MAGIC) + sizeof(int), sizeof(storedHash));
+		memcpy(counts, file + headerSize - sizeof(counts), sizeof(counts));
+		valid = version == TOKEN_CACHE_VERSION && storedHash == hash && counts[0] >= 0 && counts[1] >= 0;
+	}
+	
+	vector<string> strings;
+	const char* position = file + headerSize;
+	const char* end = file + size;
+	for (int s = 0; valid && s < counts[0]; s++)
+	{
+		int length;
+		valid = end - position >= (long)sizeof(int);
+		if (valid)
+		{
+			memcpy(&length, position, sizeof(int));
+			position += sizeof(int);
+			valid = length >= 0 && end - position >= length;
+		}
+		if (valid)
+		{
+			strings.push_back(string(position, length));
+			position += length;
+		}
+	}
+	valid = valid && end - position == (long long)counts[1] * 2 * (long long)sizeof(int);
+	
+	int firstToken = tokenList->size();
+	if (valid)
+	{
+		tokenList->reserve(firstToken + counts[1] + TRAILING_PADDING);
+		offsetList->reserve(firstToken + counts[1] + TRAILING_PADDING);
+	}
+	for (int t = 0; valid && t < counts[1]; t++)
+	{
+		int record[2];
+		memcpy(record, position, sizeof(record));
+		position += sizeof(record);
+		valid = record[0] >= 0 && record[0] < (int)strings.size() && record[1] >= 0 && record[1] < (int)sourceText.size();
+		if (valid)
+		{
+			tokenList->push_back(strings[record[0]]);
+			offsetList->push_back(record[1]);
+		}
+	}
+	if (!valid) // undo a partly read cache
+	{
+		tokenList->resize(firstToken);
+		offsetList->resize(firstToken);
+	}
+	
+	unmapFile(file, size);
+	return valid;
+}
+
+bool typeCheck(const vector<string>& tokens, const vector<int>& offsets, int start)
+{
+	checkpoint unitStart = {start, (int)declarationLog.size(), (int)exportedNames.size(), currentFunc, argumentsEnd};
+	checkpoints.push_back(unitStart);
+	
+	int end = tokens.size() - TRAILING_PADDING;
+	// the unit being profiled ends wherever checking stops
+	struct unitGuard
+	{
+		int end;
+		~unitGuard() {endUnit(end);}
+	} profiledUnit = {end};
+	beginUnit(start, offsets[start]);
+	for (int i = start; i < end; i++)
+	{
+		const string& current = tokens[i];
+		errorOffset = offsets[i];
+		
+		if (current == "{")
+		{
+			fileScope++;
+		}
+		else if (current == "}")
+		{
+			fileScope--;
+			if (fileScope == 0) // end of a top-level unit
+			{
+				checkpoint unitEnd = {i + 1, (int)declarationLog.size(), (int)exportedNames.size(), currentFunc, argumentsEnd};
+				checkpoints.push_back(unitEnd);
+				endUnit(i + 1);
+				beginUnit(i + 1, offsets[i + 1]);
+				if (cancelCheck != NULL && cancelCheck->load())
+				{
+					return false;
+				}
+			}
+		}
+		else if (types.find(current) != types.end()) // current token is a data type - line is a declaration
+		{
+			phaseScope phase(PHASE_DECLARATIONS);
+			int pointerAdd = 0;
+			if (tokens[i + 1] == "*") // pointer
+			{
+				i++;
+				pointerAdd = POINTER_TYPE;
+			}
+			if (i + 1 >= end) // declaration without a name
+			{
+				errorOffset = offsets[i + 1];
+				showError(19);
+				return false;
+			}
+			const string& name = tokens[i + 1];
+			unordered_map<string, symbolInfo*>::iterator it = symbolTable.find(name);
+			const string* next = &tokens[i + 2];
+			vector<string> arguments;
+			if (*next == "(") // function
+			{
+				if (current == "string")
+				{
+					showError(8);
+					return false;
+				}
+				
+				if (name == "Main")
+				{
+					if (it != symbolTable.end() || fileScope != 0) // main already exists in symbol table or not currently in global scope
+					{
+						showError(1);
+						return false;
+					}
+					else if (tokens[i + 2] == "(" && tokens[i + 3] != ")")
+					{
+						showError(i + 3 < end ? 2 : 19);
+						return false;
+					}
+				}
+				
+				currentFunc = name;
+				if (it != symbolTable.end() && (it->second)->getScope() == fileScope) // duplicate function
+				{
+					showError(3);
+					return false;
+				}
+				i += 2; // advancing to the arguments
+				int intoArgs = 0;
+				while (*next != ")")
+				{
+					intoArgs++;
+					next = &tokens[i + intoArgs];
+					if (types.find(*next) != types.end())
+					{
+						arguments.push_back(*next);
+					}
+				}
+				if (i + intoArgs >= end)
+				{
+					errorOffset = offsets[i + intoArgs];
+					showError(19);
+					return false;
+				}
+				int signature = internSignature(current, &arguments);
+				symbolInfo* info = new symbolInfo(fileScope, typeIndex(current), move(arguments), signature);
+				pair<string, symbolInfo*> data(name, info);
+				if (symbolTable.insert(data).second)
+				{
+					declarationLog.push_back(name);
+				}
+				else // the name is already declared in an outer scope, which keeps it
+				{
+					delete info;
+				}
+				argumentsEnd = i + intoArgs;
+				if (fileScope == 0 && name != "Main")
+				{
+					exportedNames.push_back(name);
+				}
+			}
+			else // identifier
+			{
+				i++;
+				if (it != symbolTable.end() && (it->second)->getScope() == fileScope) // duplicate id
+				{
+					showError(4);
+					return false;
+				}
+				symbolInfo* info = new symbolInfo(fileScope, typeIndex(current) + pointerAdd);
+				pair<string, symbolInfo*> data(name, info);
+				if (symbolTable.insert(data).second)
+				{
+					declarationLog.push_back(name);
+				}
+				else
+				{
+					delete info;
+				}
+				if (fileScope == 0 && i > argumentsEnd) // global variable, not a function argument
+				{
+					exportedNames.push_back(name);
+				}
+			}
+		}
+		else if (tokens[i + 1] == "(" && !operators.contains[(unsigned char)current[0]] && keywords.find(current) == keywords.end()) // function calls
+		{
+			if (findSymbol(current) != NULL)
+			{
+				int start = i; // function name
+				while (tokens[i] != ")")
+				{
+					i++;
+				}
+				if (i >= end)
+				{
+					errorOffset = offsets[i];
+					showError(19);
+					return false;
+				}
+				bool valid = functionCheck(tokens, start);
+				if (!valid)
+				{
+					return false;
+				}
+			}
+			else // function not in symbol table
+			{
+				showError(5);
+				return false;
+			}
+		}
+		else if (current == "[") // checking if indexing is being applied to a string and if the argument is an integer
+		{
+			if (tokenType(&tokens[i - 1]) != TYPE_STRING)
+			{
+				showError(13);
+				return false;
+			}
+			
+			i++;
+			int start = i;
+			while (tokens[i] != "]")
+			{
+				i++;
+			}
+			if (i >= end)
+			{
+				errorOffset = offsets[i];
+				showError(19);
+				return false;
+			}
+			
+			int expressionType = parseExpression(tokens, start, i, offsets[start]);
+			if (expressionType == TYPE_ERROR)
+			{
+				return false;
+			}
+			else if (expressionType != TYPE_INT)
+			{
+				showError(12);
+				return false;
+			}
+		}
+		else if (current == "=") // assignment
+		{
+			int lhsType = tokenType(&tokens[i - 1]);
+			if (tokens[i + 2] == "(") // assigning a function to a value
+			{
+				if (findSymbol(tokens[i + 1]) == NULL) // function not found
+				{
+					showError(5);
+					return false;
+				}
+				if (tokenType(&tokens[i + 1]) != lhsType) // mismatched types
+				{
+					showError(9);
+					return false;
+				}
+			}
+			else // assigning an expression
+			{
+				i++;
+				int start = i;
+				while (tokens[i] != ";")
+				{
+					i++;
+				}
+				if (i >= end)
+				{
+					errorOffset = offsets[i];
+					showError(19);
+					return false;
+				}
+				int rhsType = parseExpression(tokens, start, i, offsets[start]);
+				
+				if (rhsType == TYPE_ERROR)
+				{
+					return false;
+				}
+				else if (rhsType != lhsType
+				&& !(rhsType == TYPE_NULL && (lhsType == TYPE_INT + POINTER_TYPE || lhsType == TYPE_CHAR + POINTER_TYPE))) // allows null pointer to be assigned to int/char pointer
+				{
+					showError(14);
+					return false;
+				}
+			}
+		}
+		else if (current == "return")
+		{	
+			i++;
+			int start = i;
+			while (tokens[i] != ";")
+			{
+				i++;
+			}
+			if (i >= end)
+			{
+				errorOffset = offsets[i];
+				showError(19);
+				return false;
+			}
+			int returnType = parseExpression(tokens, start, i, offsets[start]);
+			
+			unordered_map<string, symbolInfo*>::iterator it = symbolTable.find(currentFunc);
+			
+			if (returnType == TYPE_ERROR)
+			{
+				return false;
+			}
+			else if (it == symbolTable.end() || (it->second)->getType() != returnType) // return outside of a function is invalid too
+			{
+				showError(8);
+				return false;
+			}
+		}
+		else if (current == "import")
+		{
+			if (i + 1 >= end)
+			{
+				errorOffset = offsets[i + 1];
+				showError(19);
+				return false;
+			}
+			i++;
+			int error = loadInterface(moduleDirectory + tokens[i] + INTERFACE_EXTENSION);
+			if (error != 0)
+			{
+				showError(error);
+				return false;
+			}
+		}
+		else if (current == "if" || current == "while")
+		{
+			i += 2;
+			int start = i;
+			while (tokens[i] != ")")
+			{
+				i++;
+			}
+			if (i >= end)
+			{
+				errorOffset = offsets[i];
+				showError(19);
+				return false;
+			}
+			int loopCondition = parseExpression(tokens, start, i, offsets[start]);
+			
+			if (loopCondition == TYPE_ERROR)
+			{
+				return false;
+			}
+			else if (loopCondition != TYPE_BOOL)
+			{
+				if (current == "if")
+				{
+					showError(10);
+				}
+				else
+				{
+					showError(11);
+				}
+				return false;
+			}
+		}
+	}
+	*diagnostics << "No type checking errors found.";
+	return true;
+}
+
+int parseExpression(const vector<string>& tokens, int begin, int end, int offset)
+{
+	phaseScope phase(PHASE_EXPRESSIONS);
+	if (currentProfile != NULL)
+	{
+		// timed as a whole, so the untimed version below is what is measured
+		fileProfile* profile = currentProfile;
+		currentProfile = NULL;
+		operationCounts before = operationsDone;
+		chrono::steady_clock::time_point started = chrono::steady_clock::now();
+		int type = parseExpression(tokens, begin, end, offset);
+		chrono::steady_clock::time_point finished = chrono::steady_clock::now();
+		currentProfile = profile;
+		
+		profileEntry entry;
+		entry.offset = offset;
+		entry.start = chrono::duration<double, micro>(started - runStarted).count();
+		entry.duration = chrono::duration<double, micro>(finished - started).count();
+		entry.operations.reductions = operationsDone.reductions - before.reductions;
+		entry.operations.lookups = operationsDone.lookups - before.lookups;
+		entry.operations.calls = operationsDone.calls - before.calls;
+		// a min heap by duration, so the fastest of the slowest expressions is the one replaced
+		auto slower = [](const profileEntry& a, const profileEntry& b) {return a.duration > b.duration;};
+		vector<profileEntry>& slowest = profile->expressions;
+		if ((int)slowest.size() < profileTop)
+		{
+			slowest.push_back(entry);
+			push_heap(slowest.begin(), slowest.end(), slower);
+		}
+		else if (entry.duration > slowest.front().duration)
+		{
+			pop_heap(slowest.begin(), slowest.end(), slower);
+			slowest.back() = entry;
+			push_heap(slowest.begin(), slowest.end(), slower);
+		}
+		return type;
+	}
+	
+	// The tokens are converted to operand types and expression codes in expressionBuffer,
+	// which is then reduced in place.
+	expressionBuffer.clear();
+	expressionBuffer.push_back(CODE_EDGE);
+	for (int i = begin; i < end; i++)
+	{
+		unordered_map<string, int>::iterator it = expressionCodes.find(tokens[i]);
+		if (it != expressionCodes.end())
+		{
+			expressionBuffer.push_back(it->second);
+		}
+		else
+		{
+			expressionBuffer.push_back(tokenType(&tokens[i]));
+		}
+	}
+	
+	if (begin == end)
+	{
+		return TYPE_VOID;
+	}
+	int bufferEnd = expressionBuffer.size();
+	expressionBuffer.push_back(CODE_EDGE);
+	return reduceExpression(1, &bufferEnd);
+}
+
+int reduceExpression(int begin, int* end)
+{
+	// This function goes through all the expression operators (and parentheses) in
+	// their appropriate evaluation order. It resolves each operator by removing all
+	// elements used by the operator, then replaces the operator with the operator's
+	// output type.
+	// ex. The sequence int, <, int will have both ints removed, then < replaced with bool.
+	vector<int>& expression = expressionBuffer;
+	
+	int foundLoc = findFirst(&expression, begin, *end, CODE_OPEN_PAREN);
+	while (foundLoc != -1)
+	{
+		int subExprType = reduceGroup(foundLoc, findClose(&expression, foundLoc, *end), end);
+		if (subExprType == TYPE_ERROR)
+		{
+			return TYPE_ERROR;
+		}
+		operationsDone.reductions++;
+		expression[foundLoc] = subExprType;
+		
+		foundLoc = findFirst(&expression, begin, *end, CODE_OPEN_PAREN);
+	}
+	
+	foundLoc = findFirst(&expression, begin, *end, CODE_OPEN_BRACKET);
+	while (foundLoc != -1)
+	{
+		if (operandType(expression[foundLoc - 1]) != TYPE_STRING)
+		{
+			showError(13);
+			return TYPE_ERROR;
+		}
+		
+		int expressionType = reduceGroup(foundLoc, findClose(&expression, foundLoc, *end), end);
+		if (expressionType == TYPE_ERROR)
+		{
+			return TYPE_ERROR;
+		}
+		else if (expressionType != TYPE_INT)
+		{
+			showError(12);
+			return TYPE_ERROR;
+		}
+		
+		operationsDone.reductions++;
+		expression[foundLoc] = TYPE_CHAR;
+		expression.erase(expression.begin() + foundLoc - 1); // erasing string id
+		(*end)--;
+		
+		foundLoc = findFirst(&expression, begin, *end, CODE_OPEN_BRACKET);
+	}
+	
+	foundLoc = findFirst(&expression, begin, *end, CODE_BAR);
+	while (foundLoc != -1)
+	{
+		int close = findFirst(&expression, foundLoc + 1, *end, CODE_BAR);
+		int subExprType = reduceGroup(foundLoc, close == -1 ? *end : close, end);
+		if (subExprType == TYPE_ERROR)
+		{
+			return TYPE_ERROR;
+		}
+		else if (subExprType != TYPE_INT)
+		{
+			showError(15);
+			return TYPE_ERROR;
+		}
+		operationsDone.reductions++;
+		expression[foundLoc] = TYPE_INT;
+		
+		foundLoc = findFirst(&expression, begin, *end, CODE_BAR);
+	}
+	
+	for (int op = 0; op < UNARY_COUNT; op++)
+	{
+		foundLoc = findFirst(&expression, begin, *end, CODE_UNARY + op);
+		while (foundLoc != -1)
+		{
+			int result = operatorRules.unary[op][operandType(expression[foundLoc + 1])];
+			if (result < 0)
+			{
+				showError(-result);
+				return TYPE_ERROR;
+			}
+			operationsDone.reductions++;
+			expression[foundLoc] = result;
+			expression.erase(expression.begin() + foundLoc + 1);
+			(*end)--;
+			
+			foundLoc = findFirst(&expression, begin, *end, CODE_UNARY + op);
+		}
+	}
+	
+	for (int op = 0; op < BINARY_COUNT; op++)
+	{
+		foundLoc = findFirst(&expression, begin, *end, CODE_BINARY + op);
+		while (foundLoc != -1)
+		{
+			int left = operandType(expression[foundLoc - 1]);
+			int right = operandType(expression[foundLoc + 1]);
+			int result = operatorRules.binary[op][left][right];
+			if (result < 0)
+			{
+				showError(-result);
+				return TYPE_ERROR;
+			}
+			operationsDone.reductions++;
+			expression[foundLoc] = result;
+			expression.erase(expression.begin() + foundLoc + 1);
+			expression.erase(expression.begin() + foundLoc - 1);
+			*end -= 2;
+			
+			foundLoc = findFirst(&expression, begin, *end, CODE_BINARY + op);
+		}
+	}
+	
+	// anything left over after the first operand is ignored
+	int type = operandType(expression[begin]);
+	expression.erase(expression.begin() + begin + 1, expression.begin() + *end);
+	*end = begin + 1;
+	return type;
+}
+
+int reduceGroup(int open, int close, int* end)
+{
+	vector<int>& expression = expressionBuffer;
+	int type = TYPE_VOID;
+	int innerEnd = close;
+	if (open + 1 < close)
+	{
+		type = reduceExpression(open + 1, &innerEnd);
+		if (type == TYPE_ERROR)
+		{
+			return TYPE_ERROR;
+		}
+		*end -= close - innerEnd;
+	}
+	
+	if (innerEnd < *end) // erasing the closing element too
+	{
+		innerEnd++;
+	}
+	*end -= innerEnd - (open + 1);
+	expression.erase(expression.begin() + open + 1, expression.begin() + innerEnd);
+	return type;
+}
+
+int operandType(int element)
+{
+	if (element < TYPE_COUNT)
+	{
+		return element;
+	}
+	else if (element == CODE_CLOSE_BRACKET) // tokenType reads "]" as the end of an indexed string
+	{
+		return TYPE_CHAR;
+	}
+	return TYPE_VOID;
+}
+
+int tokenType(const string* token)
+{
+	symbolInfo* symbol = findSymbol(*token);
+	if (symbol != NULL) // if in symbol table
+	{
+		return symbol->getType();
+	}
+	
+	// if not in symbol table, must be a literal to be valid
+	int start = 0;
+	int pointerAdd = 0;
+	if ((*token)[0] == '*') // pointer "literal" signifier, can't exist in the input file
+	{
+		start = 1;
+		pointerAdd = POINTER_TYPE;
+	}
+	char first = (*token)[start];
+	
+	if (token->find('\"', start) != string::npos)
+	{
+		return pointerAdd + TYPE_STRING;
+	}
+	else if (token->find('\'', start) != string::npos || token->compare(start, string::npos, "]") == 0)
+	{
+		return pointerAdd + TYPE_CHAR;
+	}
+	else if (first > 47 && first < 58)
+	{
+		if (token->find('.', start) != string::npos)
+		{
+			return pointerAdd + TYPE_DOUBLE;
+		}
+		else
+		{
+			return pointerAdd + TYPE_INT;
+		}
+	}
+	else if (token->compare(start, string::npos, "true") == 0 || token->compare(start, string::npos, "false") == 0)
+	{
+		return pointerAdd + TYPE_BOOL;
+	}
+	else
+	{
+		if (pointerAdd != 0)
+		{
+			return TYPE_NULL; // null pointer
+		}
+		return TYPE_VOID;
+	}
+}
+
+int typeIndex(const string& type)
+{
+	return typeIds.find(type)->second;
+}
+
+int findFirst(const vector<int>* vect, int begin, int end, int search)
+{
+	for (int i = begin; i < end; i++)
+	{
+		if ((*vect)[i] == search)
+		{
+			return i;
+		}
+	}
+	return -1; // search not found
+}
+
+int findClose(const vector<int>* vect, int open, int end)
+{
+	int depth = 0;
+	for (int i = open + 1; i < end; i++)
+	{
+		if ((*vect)[i] == (*vect)[open])
+		{
+			depth++;
+		}
+		else if ((*vect)[i] == (*vect)[open] + 1) // each closing code follows its opening code
+		{
+			if (depth == 0)
+			{
+				return i;
+			}
+			depth--;
+		}
+	}
+	return end; // group never closed
+}
+
+int internSignature(const string& returnType, vector<string>* arguments)
+{
+	signatureKey = returnType;
+	signatureKey += '(';
+	for (size_t i = 0; i < arguments->size(); i++)
+	{
+		if (i > 0)
+		{
+			signatureKey += ',';
+		}
+		signatureKey += (*arguments)[i];
+	}
+	signatureKey += ')';
+	
+	int id = findSignature(signatureKey);
+	if (id != -1)
+	{
+		return id;
+	}
+	id = LOCAL_SIGNATURE_BASE + signatureIds.size();
+	signatureIds.insert(pair<string, int>(signatureKey, id));
+	return id;
+}
+
+int findSignature(const string& key)
+{
+	if (preludeSignatureCount > 0)
+	{
+		int signature = findPreludeEntry(key, preludeSignatureIndex, preludeSignatureSlots, preludeSignatures,
+			PRELUDE_SIGNATURE_RECORD);
+		if (signature != -1)
+		{
+			return signature;
+		}
+	}
+	unordered_map<string, int>::iterator it = signatureIds.find(key);
+	return it == signatureIds.end() ? -1 : it->second;
+}
+
+bool functionCheck(const vector<string>& tokens, int start)
+{
+	phaseScope phase(PHASE_CALLS);
+	operationsDone.calls++;
+	symbolInfo* function = findSymbol(tokens[start]);
+	if (function != NULL && function->getScope() <= fileScope)
+	{
+		// build the call's signature key the same way internSignature does, then compare IDs
+		signatureKey = typeNames[function->getType()];
+		signatureKey += '(';
+		int argumentCount = 0;
+		for (int i = start + 2; tokens[i] != ")"; i++) // start past the first ( of the function call
+		{
+			if (tokens[i] != ",")
+			{
+				if (argumentCount > 0)
+				{
+					signatureKey += ',';
+				}
+				signatureKey += typeNames[tokenType(&tokens[i])];
+				argumentCount++;
+			}
+		}
+		signatureKey += ')';
+		
+		int signature = findSignature(signatureKey);
+		if (signature != -1 && signature == function->getSignature())
+		{
+			return true;
+		}
+		
+		// the signatures differ, so either the count or at least one type is wrong
+		if (argumentCount != (int)function->getArguments().size())
+		{
+			showError(6);
+			return false;
+		}
+		else if (argumentCount > 0)
+		{
+			showError(7);
+			return false;
+		}
+		return true; // a variable called with no arguments has no signature but nothing to mismatch
+	}
+	else // function does not exist in the current scope
+	{
+		showError(5);
+		return false;
+	}
+}
+
+void findLocation(int offset, int* line, int* column)
+{
+	if (lineStarts.empty())
+	{
+		lineStarts.push_back(0);
+		const char* start = sourceText.data();
+		const char* end = start + sourceText.size();
+		const char* found = (const char*)memchr(start, '\n', end - start);
+		while (found != NULL)
+		{
+			lineStarts.push_back(found - start + 1);
+			found = (const char*)memchr(found + 1, '\n', end - found - 1);
+		}
+	}
+	
+	// the line is the last line start that is not past the offset
+	int index = upper_bound(lineStarts.begin(), lineStarts.end(), offset) - lineStarts.begin() - 1;
+	*line = index + 1;
+	*column = offset - lineStarts[index] + 1;
+}
+
+bool checkModules(const vector<string>& fileNames)
+{
+	vector<moduleInfo> modules(fileNames.size());
+	unordered_map<string, int> moduleIndex;
+	for (size_t m = 0; m < modules.size(); m++)
+	{
+		moduleInfo& module = modules[m];
+		module.fileName = fileNames[m];
+		module.passed = false;
+		size_t slash = module.fileName.find_last_of("/\\");
+		int nameStart = slash == string::npos ? 0 : slash + 1;
+		module.directory = module.fileName.substr(0, nameStart);
+		module.name = module.fileName.substr(nameStart, module.fileName.find('.', nameStart) - nameStart);
+		moduleIndex.insert(pair<string, int>(module.directory + module.name, m));
+	}
+	
+	// one thread reads the files while the others lex each file as soon as it has been read
+	mutex lock;
+	condition_variable wake;
+	vector<int> readFilesQueue; // files read but not yet lexed
+	thread reader([&]()
+	{
+		readFiles(fileNames, [&](int m, string* text, int error)
+		{
+			modules[m].source.swap(*text);
+			modules[m].readError = error;
+			lock_guard<mutex> guard(lock);
+			readFilesQueue.push_back(m);
+			wake.notify_one();
+		});
+	});
+	runParallel(modules.size(), [&](int)
+	{
+		int m;
+		{
+			unique_lock<mutex> guard(lock);
+			wake.wait(guard, [&]() {return !readFilesQueue.empty();});
+			m = readFilesQueue.back();
+			readFilesQueue.pop_back();
+		}
+		moduleInfo& module = modules[m];
+		if (module.readError != 0)
+		{
+			return;
+		}
+		sourceText.swap(module.source);
+		lineStarts.clear();
+		tokenizeSource(module.fileName, &module.tokens, &module.offsets);
+		module.source.swap(sourceText);
+		for (size_t i = LEADING_PADDING; i < module.tokens.size() - TRAILING_PADDING; i++)
+		{
+			if (module.tokens[i] == "import")
+			{
+				module.imports.push_back(module.tokens[i + 1]);
+				module.importOffsets.push_back(module.offsets[i]);
+			}
+		}
+	});
+	reader.join();
+	
+	workerPool pool;
+	// profiles are kept in this process's memory, so profiled batches are checked on threads
+	bool usingWorkers = workerCount > 0 && profileTop == 0 && tracePath == "" && startWorkers(&pool, &modules);
+	
+	// each wave holds the files whose imports from this batch have all been checked
+	vector<bool> done(modules.size(), false);
+	int remaining = modules.size();
+	for (size_t m = 0; m < modules.size(); m++)
+	{
+		if (modules[m].readError != 0) // fails without a check, and so do the files importing it
+		{
+			modules[m].output = string("The file could not be read: ") + strerror(modules[m].readError) + ".";
+			remove((modules[m].directory + modules[m].name + INTERFACE_EXTENSION).c_str());
+			done[m] = true;
+			remaining--;
+		}
+	}
+	while (remaining > 0)
+	{
+		vector<int> wave;
+		int failed = 0; // files failed without being checked because a file they import failed
+		for (size_t m = 0; m < modules.size(); m++)
+		{
+			moduleInfo& module = modules[m];
+			bool ready = !done[m];
+			int failedImport = -1;
+			for (size_t d = 0; ready && d < module.imports.size(); d++)
+			{
+				unordered_map<string, int>::iterator it = moduleIndex.find(module.directory + module.imports[d]);
+				ready = it == moduleIndex.end() || done[it->second];
+				if (ready && it != moduleIndex.end() && !modules[it->second].passed && failedImport == -1)
+				{
+					failedImport = d;
+				}
+			}
+			if (ready && failedImport != -1) // its interface on disk would be stale, so it is not used
+			{
+				ostringstream output;
+				diagnostics = &output;
+				sourceText.swap(module.source);
+				lineStarts.clear();
+				errorOffset = module.importOffsets[failedImport];
+				showError(21);
+				lineStarts.clear();
+				module.source.swap(sourceText);
+				diagnostics = &cout;
+				module.output = output.str();
+				remove((module.directory + module.name + INTERFACE_EXTENSION).c_str());
+				done[m] = true;
+				failed++;
+			}
+			else if (ready)
+			{
+				wave.push_back(m);
+			}
+		}
+		remaining -= failed;
+		if (wave.empty() && failed > 0)
+		{
+			continue;
+		}
+		if (wave.empty()) // import cycle, so check the rest together and let the missing interfaces be reported
+		{
+			for (size_t m = 0; m < modules.size(); m++)
+			{
+				if (!done[m])
+				{
+					// none of them has been checked yet, so an interface left from an earlier run is not used
+					remove((modules[m].directory + modules[m].name + INTERFACE_EXTENSION).c_str());
+					wave.push_back(m);
+				}
+			}
+		}
+		
+		if (usingWorkers)
+		{
+			checkInWorkers(&pool, wave, &modules);
+		}
+		else
+		{
+			runParallel(wave.size(), [&](int w)
+			{
+				checkModule(&modules[wave[w]]);
+			});
+		}
+		for (size_t w = 0; w < wave.size(); w++)
+		{
+			done[wave[w]] = true;
+		}
+		remaining -= wave.size();
+	}
+	
+	if (usingWorkers)
+	{
+		stopWorkers(&pool);
+	}
+	
+	bool allPassed = true;
+	for (size_t m = 0; m < modules.size(); m++)
+	{
+		cout << modules[m].fileName << ": " << modules[m].output << endl;
+		allPassed = allPassed && modules[m].passed;
+	}
+	return allPassed;
+}
+
+void checkModule(moduleInfo* module)
+{
+	ostringstream output;
+	resetChecker();
+	diagnostics = &output;
+	moduleDirectory = module->directory;
+	sourceText.swap(module->source);
+	beginProfile(module->fileName);
+	module->passed = typeCheck(module->tokens, module->offsets, LEADING_PADDING);
+	endProfile();
+	string interfacePath = module->directory + module->name + INTERFACE_EXTENSION;
+	if (module->passed)
+	{
+		writeInterface(interfacePath, module->fileName.substr(module->directory.size()));
+	}
+	else // so files importing it are not checked against an interface it no longer has
+	{
+		remove(interfacePath.c_str());
+	}
+	module->output = output.str();
+	diagnostics = &cout;
+}
+
+bool startWorkers(workerPool* pool, vector<moduleInfo>* modules)
+{
+#ifndef _WIN32
+	void* shared = mmap(NULL, sizeof(resultRing), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (shared == MAP_FAILED)
+	{
+		return false;
+	}
+	pool->ring = new (shared) resultRing();
+	pool->ring->next = 0;
+	for (int s = 0; s < RESULT_SLOTS; s++)
+	{
+		pool->ring->slots[s].state = SLOT_FREE;
+	}
+	int notify[2];
+	if (pipe(notify) == -1)
+	{
+		munmap(shared, sizeof(resultRing));
+		return false;
+	}
+	pool->notifyRead = notify[0];
+	pool->notifyWrite = notify[1];
+	signal(SIGPIPE, SIG_IGN); // a worker that died is noticed through waitpid instead
+	
+	pool->workers.resize(min<int>(workerCount, modules->size()));
+	for (size_t w = 0; w < pool->workers.size(); w++)
+	{
+		pool->workers[w].pid = -1;
+		pool->workers[w].jobs = -1;
+	}
+	for (size_t w = 0; w < pool->workers.size(); w++)
+	{
+		if (!startWorker(pool, w, modules))
+		{
+			stopWorkers(pool);
+			return false;
+		}
+	}
+	return true;
+#else
+	return false;
+#endif
+}
+
+bool startWorker(workerPool* pool, int index, vector<moduleInfo>* modules)
+{
+#ifndef _WIN32
+	int jobs[2];
+	if (pipe(jobs) == -1)
+	{
+		return false;
+	}
+	int pid = fork();
+	if (pid == -1)
+	{
+		close(jobs[0]);
+		close(jobs[1]);
+		return false;
+	}
+	if (pid == 0)
+	{
+		// only this worker's end of its own job pipe stays open, so every worker sees its pipe close
+		close(jobs[1]);
+		close(pool->notifyRead);
+		for (size_t w = 0; w < pool->workers.size(); w++)
+		{
+			if (pool->workers[w].jobs != -1)
+			{
+				close(pool->workers[w].jobs);
+			}
+		}
+		pool->workers[index].jobs = jobs[0];
+		runWorker(pool, index, modules);
+	}
+	close(jobs[0]);
+	workerProcess& worker = pool->workers[index];
+	worker.pid = pid;
+	worker.jobs = jobs[1];
+	worker.file = -1;
+	return true;
+#else
+	return false;
+#endif
+}
+
+void runWorker(workerPool* pool, int index, vector<moduleInfo>* modules)
+{
+#ifndef _WIN32
+	int jobs = pool->workers[index].jobs;
+	int file;
+	while (read(jobs, &file, sizeof(file)) == sizeof(file))
+	{
+		moduleInfo& module = (*modules)[file];
+		checkModule(&module);
+		
+		// claim the next slot, waiting for the parent to free it if the ring has come all the way round
+		int slotIndex = pool->ring->next++ % RESULT_SLOTS;
+		resultSlot& slot = pool->ring->slots[slotIndex];
+		int expected = SLOT_FREE;
+		while (!slot.state.compare_exchange_weak(expected, SLOT_WRITING))
+		{
+			expected = SLOT_FREE;
+			usleep(100);
+		}
+		slot.owner = getpid();
+		slot.file = file;
+		slot.passed = module.passed;
+		slot.length = min<int>(module.output.size(), RESULT_TEXT_SIZE);
+		slot.omitted = module.output.size() - slot.length;
+		memcpy(slot.text, module.output.data(), slot.length);
+		slot.state = SLOT_READY;
+		if (write(pool->notifyWrite, &slotIndex, sizeof(slotIndex)) != sizeof(slotIndex))
+		{
+			break;
+		}
+	}
+	_exit(0);
+#endif
+}
+
+void checkInWorkers(workerPool* pool, const vector<int>& files, vector<moduleInfo>* modules)
+{
+#ifndef _WIN32
+	int next = 0;
+	int remaining = files.size();
+	
+	// copies the result out of a ready slot and frees it
+	auto take = [&](int slotIndex)
+	{
+		resultSlot& slot = pool->ring->slots[slotIndex];
+		moduleInfo& module = (*modules)[slot.file];
+		module.passed = slot.passed;
+		module.output.assign(slot.text, slot.length);
+		if (slot.omitted > 0)
+		{
+			module.output += "\n(" + to_string(slot.omitted) + " more bytes of output were cut off)";
+		}
+		for (size_t w = 0; w < pool->workers.size(); w++)
 		{
-			if (symbolTable.find(current) != symbolTable.end())
+			if (pool->workers[w].pid == slot.owner)
 			{
-				vector<string> function;
-				function.push_back(current); // function name
-				while (current != ")")
-				{
-					i++;
-					current = tokens[i];
-					function.push_back(current);
-				}
-				bool valid = functionCheck(function);
-				if (!valid)
-				{
-					return;
-				}
+				pool->workers[w].file = -1;
 			}
-			else // function not in symbol table
+		}
+		slot.state = SLOT_FREE;
+		remaining--;
+	};
+	
+	// copies out every result the workers have announced, waiting at most the passed number of milliseconds
+	auto collect = [&](int timeout)
+	{
+		pollfd notifications = {pool->notifyRead, POLLIN, 0};
+		while (poll(&notifications, 1, timeout) > 0)
+		{
+			int slotIndex;
+			if (read(pool->notifyRead, &slotIndex, sizeof(slotIndex)) != sizeof(slotIndex))
 			{
-				showError(5);
-				return;
+				break;
 			}
+			take(slotIndex);
+			timeout = 0; // take whatever else is already waiting without blocking again
 		}
-		else if (current == "[") // checking if indexing is being applied to a string and if the argument is an integer
+	};
+	
+	while (remaining > 0)
+	{
+		for (size_t w = 0; w < pool->workers.size() && next < (int)files.size(); w++)
 		{
-			if (tokenType(&tokens[i - 1]) != "string")
+			workerProcess& worker = pool->workers[w];
+			if (worker.file == -1 && worker.pid != -1)
 			{
-				showError(13);
-				return;
+				worker.file = files[next++];
+				worker.started = chrono::steady_clock::now();
+				if (write(worker.jobs, &worker.file, sizeof(worker.file)) != sizeof(worker.file))
+				{
+					// the worker is gone, so the file goes back to be sent again once it is replaced below
+					worker.file = -1;
+					next--;
+					kill(worker.pid, SIGKILL);
+				}
 			}
-			
-			vector<string> expression;
-			i++;
-			current = tokens[i];
-			while (current != "]")
+		}
+		
+		collect(100);
+		
+		// replace workers that died or ran out of time, failing the file each was checking
+		for (size_t w = 0; w < pool->workers.size(); w++)
+		{
+			workerProcess& worker = pool->workers[w];
+			if (worker.pid == -1)
 			{
-				expression.push_back(current);
-				i++;
-				current = tokens[i];
+				continue;
 			}
-			
-			string expressionType = parseExpression(expression);
-			if (expressionType == "e")
+			int status;
+			bool exited = waitpid(worker.pid, &status, WNOHANG) == worker.pid;
+			bool timedOut = !exited && worker.file != -1
+				&& chrono::steady_clock::now() - worker.started > chrono::milliseconds(workerTimeout);
+			if (!exited && !timedOut)
 			{
-				return;
+				continue;
 			}
-			else if (expressionType != "int")
+			if (timedOut)
 			{
-				showError(12);
-				return;
+				kill(worker.pid, SIGKILL);
+				waitpid(worker.pid, &status, 0);
 			}
-		}
-		else if (current == "=") // assignment
-		{
-			string lhsType = tokenType(&tokens[i - 1]);
-			if (tokens[i + 2] == "(") // assigning a function to a value
+			collect(0); // it may have published its result just before it stopped
+			for (int s = 0; s < RESULT_SLOTS; s++) // slots it stopped in the middle of writing or announcing
 			{
-				if (symbolTable.find(tokens[i + 1]) == symbolTable.end()) // function not found
+				resultSlot& slot = pool->ring->slots[s];
+				if (slot.state == SLOT_READY && slot.owner == worker.pid) // written, but never announced
 				{
-					showError(5);
-					return;
+					take(s);
 				}
-				if (tokenType(&tokens[i + 1]) != lhsType) // mismatched types
+				else if (slot.state == SLOT_WRITING && slot.owner == worker.pid)
 				{
-					showError(9);
-					return;
+					slot.state = SLOT_FREE;
 				}
 			}
-			else // assigning an expression
+			if (worker.file != -1)
 			{
-				vector<string> expression;
-				i++;
-				current = tokens[i];
-				while (current != ";")
+				moduleInfo& module = (*modules)[worker.file];
+				ostringstream output;
+				if (timedOut)
 				{
-					expression.push_back(current);
-					i++;
-					current = tokens[i];
+					output << "The checker did not finish within " << workerTimeout << " ms.";
 				}
-				string rhsType = parseExpression(expression);
-				
-				if (rhsType == "e")
+				else if (WIFSIGNALED(status))
 				{
-					return;
+					output << "The checker crashed (signal " << WTERMSIG(status) << ").";
 				}
-				else if (rhsType != lhsType
-				&& !(rhsType == "*null" && (lhsType == "*int" || lhsType == "*char"))) // allows null pointer to be assigned to int/char pointer
+				else
 				{
-					showError(14);
-					return;
+					output << "The checker exited unexpectedly.";
 				}
+				output << endl << "Type check failed.";
+				module.output = output.str();
+				module.passed = false;
+				remaining--;
 			}
+			
+			close(worker.jobs);
+			worker.pid = -1;
+			worker.jobs = -1;
+			worker.file = -1;
+			startWorker(pool, w, modules);
 		}
-		else if (current == "return")
-		{	
-			vector<string> expression;
-			i++;
-			string next = tokens[i];
-			while (next != ";")
+		
+		bool anyWorkers = false;
+		for (size_t w = 0; w < pool->workers.size(); w++)
+		{
+			anyWorkers = anyWorkers || pool->workers[w].pid != -1;
+		}
+		if (!anyWorkers) // no worker could be started again, so the rest are checked here
+		{
+			for (; next < (int)files.size(); next++)
 			{
-				expression.push_back(next);
-				i++;
-				next = tokens[i];
+				checkModule(&(*modules)[files[next]]);
+				remaining--;
 			}
-			string returnType = parseExpression(expression);
-			
-			unordered_map<string, symbolInfo*>::iterator it = symbolTable.find(currentFunc);
-			
-			if (returnType == "e")
+		}
+	}
+#endif
+}
+
+void stopWorkers(workerPool* pool)
+{
+#ifndef _WIN32
+	for (size_t w = 0; w < pool->workers.size(); w++)
+	{
+		if (pool->workers[w].pid != -1)
+		{
+			close(pool->workers[w].jobs);
+			waitpid(pool->workers[w].pid, NULL, 0);
+		}
+	}
+	close(pool->notifyRead);
+	close(pool->notifyWrite);
+	munmap(pool->ring, sizeof(resultRing));
+	signal(SIGPIPE, SIG_DFL);
+#endif
+}
+
+void beginProfile(const string& fileName)
+{
+	if (profileTop == 0)
+	{
+		return;
+	}
+	static atomic<int> threadCount(0);
+	thread_local int thread = threadCount++;
+	currentProfile = new fileProfile();
+	currentProfile->fileName = fileName;
+	currentProfile->thread = thread;
+	currentProfile->unitOpen = false;
+	currentProfile->start = chrono::duration<double, micro>(chrono::steady_clock::now() - runStarted).count();
+}
+
+void endProfile()
+{
+	fileProfile* profile = currentProfile;
+	if (profile == NULL)
+	{
+		return;
+	}
+	currentProfile = NULL;
+	profile->duration = chrono::duration<double, micro>(chrono::steady_clock::now() - runStarted).count() - profile->start;
+	
+	sort(profile->expressions.begin(), profile->expressions.end(), [](const profileEntry& a, const profileEntry& b)
+	{
+		return a.duration > b.duration;
+	});
+	for (size_t e = 0; e < profile->expressions.size(); e++)
+	{
+		profileEntry& expression = profile->expressions[e];
+		int column;
+		findLocation(expression.offset, &expression.line, &column);
+		// the whole source line, without its indentation
+		size_t lineStart = expression.offset - (column - 1);
+		size_t lineEnd = min(sourceText.find('\n', expression.offset), sourceText.size());
+		while (lineStart < lineEnd && (sourceText[lineStart] == ' ' || sourceText[lineStart] == '\t'))
+		{
+			lineStart++;
+		}
+		if (lineEnd > lineStart && sourceText[lineEnd - 1] == '\r')
+		{
+			lineEnd--;
+		}
+		const size_t longest = 100; // generated lines can be very long
+		expression.name = sourceText.substr(lineStart, min(lineEnd - lineStart, longest));
+		if (lineEnd - lineStart > longest)
+		{
+			expression.name += "...";
+		}
+	}
+	for (size_t f = 0; f < profile->functions.size(); f++)
+	{
+		int column;
+		findLocation(profile->functions[f].offset, &profile->functions[f].line, &column);
+	}
+	
+	lock_guard<mutex> guard(profilesLock);
+	profiles.push_back(profile);
+}
+
+void beginUnit(int token, int offset)
+{
+	if (currentProfile == NULL)
+	{
+		return;
+	}
+	currentProfile->unitToken = token;
+	currentProfile->unitFunction = currentFunc;
+	currentProfile->unitOperations = operationsDone;
+	currentProfile->unitStarted = chrono::steady_clock::now();
+	currentProfile->functions.push_back(profileEntry()); // filled in by endUnit
+	currentProfile->functions.back().offset = offset;
+	currentProfile->unitOpen = true;
+}
+
+void endUnit(int token)
+{
+	fileProfile* profile = currentProfile;
+	if (profile == NULL || !profile->unitOpen)
+	{
+		return;
+	}
+	profile->unitOpen = false;
+	chrono::steady_clock::time_point finished = chrono::steady_clock::now();
+	if (token <= profile->unitToken) // nothing was left to check
+	{
+		profile->functions.pop_back();
+		return;
+	}
+	profileEntry& unit = profile->functions.back();
+	unit.name = currentFunc != profile->unitFunction ? currentFunc : "(global declarations)";
+	unit.start = chrono::duration<double, micro>(profile->unitStarted - runStarted).count();
+	unit.duration = chrono::duration<double, micro>(finished - profile->unitStarted).count();
+	unit.operations.reductions = operationsDone.reductions - profile->unitOperations.reductions;
+	unit.operations.lookups = operationsDone.lookups - profile->unitOperations.lookups;
+	unit.operations.calls = operationsDone.calls - profile->unitOperations.calls;
+}
+
+void reportProfiles()
+{
+	for (size_t p = 0; p < profiles.size(); p++)
+	{
+		fileProfile* profile = profiles[p];
+		vector<profileEntry> functions = profile->functions;
+		sort(functions.begin(), functions.end(), [](const profileEntry& a, const profileEntry& b)
+		{
+			return a.duration > b.duration;
+		});
+		functions.resize(min<int>(functions.size(), profileTop));
+		
+		cout << endl << "Profile of " << profile->fileName << ": " << fixed << setprecision(3) << profile->duration / 1000 << " ms checking" << endl;
+		cout << "Top-level functions by time:" << endl;
+		cout << setw(12) << "ms" << setw(12) << "reductions" << setw(12) << "lookups" << setw(8) << "calls" << setw(8) << "line" << "  function" << endl;
+		for (size_t f = 0; f < functions.size(); f++)
+		{
+			const profileEntry& function = functions[f];
+			cout << setw(12) << function.duration / 1000 << setw(12) << function.operations.reductions << setw(12)
+				<< function.operations.lookups << setw(8) << function.operations.calls << setw(8) << function.line << "  " << function.name << endl;
+		}
+		cout << "Slowest expressions:" << endl;
+		cout << setw(12) << "us" << setw(12) << "reductions" << setw(12) << "lookups" << setw(8) << "line" << "  source" << endl;
+		for (size_t e = 0; e < profile->expressions.size(); e++)
+		{
+			const profileEntry& expression = profile->expressions[e];
+			cout << setw(12) << expression.duration << setw(12) << expression.operations.reductions << setw(12)
+				<< expression.operations.lookups << setw(8) << expression.line << "  " << expression.name << endl;
+		}
+	}
+	
+	if (tracePath == "")
+	{
+		return;
+	}
+	ofstream trace(tracePath.c_str());
+	trace << "{\"traceEvents\":[" << endl;
+	bool first = true;
+	for (size_t p = 0; p < profiles.size(); p++)
+	{
+		fileProfile* profile = profiles[p];
+		operationCounts none = {0, 0, 0};
+		vector<string> events(1, traceEvent(profile->fileName, "file", profile->thread, profile->start, profile->duration, none));
+		for (size_t f = 0; f < profile->functions.size(); f++)
+		{
+			const profileEntry& function = profile->functions[f];
+			events.push_back(traceEvent(function.name, "function", profile->thread, function.start, function.duration, function.operations));
+		}
+		for (size_t e = 0; e < profile->expressions.size(); e++)
+		{
+			const profileEntry& expression = profile->expressions[e];
+			events.push_back(traceEvent(expression.name, "expression", profile->thread, expression.start, expression.duration, expression.operations));
+		}
+		for (size_t e = 0; e < events.size(); e++)
+		{
+			trace << (first ? "" : ",\n") << events[e];
+			first = false;
+		}
+	}
+	trace << endl << "],\"displayTimeUnit\":\"ms\"}" << endl;
+	if (!trace.good())
+	{
+		cout << "The trace could not be written to " << tracePath << "." << endl;
+	}
+}
+
+string traceEvent(const string& name, const char* category, int thread, double start, double duration, const operationCounts& operations)
+{
+	ostringstream event;
+	event << fixed << setprecision(3) << "{\"name\":" << jsonString(name) << ",\"cat\":\"" << category << "\",\"ph\":\"X\",\"pid\":1,\"tid\":"
+		<< thread << ",\"ts\":" << start << ",\"dur\":" << duration << ",\"args\":{\"reductions\":" << operations.reductions
+		<< ",\"lookups\":" << operations.lookups << ",\"calls\":" << operations.calls << "}}";
+	return event.str();
+}
+
+void runParallel(int count, const function<void(int)>& task)
+{
+	atomic<int> next(0);
+	int available = availableThreads();
+	int threadCount = max<int>(1, min<int>(count, available));
+	int share = available / threadCount;
+	vector<thread> threads;
+	for (int t = 1; t < threadCount; t++)
+	{
+		threads.push_back(thread([&]()
+		{
+			threadShare = share;
+			for (int i = next++; i < count; i = next++)
 			{
-				return;
+				task(i);
 			}
-			else if ((it->second)->getType() != returnType)
+		}));
+	}
+	int outerShare = threadShare;
+	threadShare = share;
+	for (int i = next++; i < count; i = next++) // this thread works too
+	{
+		task(i);
+	}
+	threadShare = outerShare;
+	for (size_t t = 0; t < threads.size(); t++)
+	{
+		threads[t].join();
+	}
+}
+
+int availableThreads()
+{
+	return threadShare > 0 ? threadShare : max<int>(1, thread::hardware_concurrency());
+}
+
+void readFiles(const vector<string>& fileNames, const function<void(int, string*, int)>& ready)
+{
+	if (useIoUring && readFilesUring(fileNames, ready))
+	{
+		return;
+	}
+	// blocking reads, with as many in flight as there are threads
+	int threadCount = min<int>(READ_QUEUE_DEPTH, max<int>(4, thread::hardware_concurrency()));
+	atomic<int> next(0);
+	vector<thread> threads;
+	for (int t = 0; t < min<int>(threadCount, fileNames.size()); t++)
+	{
+		threads.push_back(thread([&]()
+		{
+			string text;
+			for (int i = next++; i < (int)fileNames.size(); i = next++)
 			{
-				showError(8);
-				return;
+				int error = readFile(fileNames[i], &text);
+				ready(i, &text, error);
 			}
+		}));
+	}
+	for (size_t t = 0; t < threads.size(); t++)
+	{
+		threads[t].join();
+	}
+}
+
+bool readFilesUring(const vector<string>& fileNames, const function<void(int, string*, int)>& ready)
+{
+#ifdef USE_IO_URING
+	io_uring_params params;
+	memset(&params, 0, sizeof(params));
+	int ring = syscall(__NR_io_uring_setup, READ_QUEUE_DEPTH, &params);
+	if (ring < 0)
+	{
+		return false;
+	}
+	
+	// asked once, so a kernel without one of the operations has the whole batch read the usual way
+	const int probedOps = 256;
+	vector<char> probeMemory(sizeof(io_uring_probe) + probedOps * sizeof(io_uring_probe_op), 0);
+	io_uring_probe* probe = (io_uring_probe*)probeMemory.data();
+	bool supported = syscall(__NR_io_uring_register, ring, IORING_REGISTER_PROBE, probe, probedOps) == 0;
+	const int neededOps[3] = {IORING_OP_OPENAT, IORING_OP_STATX, IORING_OP_READ};
+	for (int o = 0; supported && o < 3; o++)
+	{
+		supported = neededOps[o] < probe->ops_len && (probe->ops[neededOps[o]].flags & IO_URING_OP_SUPPORTED);
+	}
+	if (!supported)
+	{
+		close(ring);
+		return false;
+	}
+	
+	// map the submission queue, the completion queue (which may share the first mapping) and the queue entries
+	size_t submitSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	size_t completeSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+	bool singleMapping = params.features & IORING_FEAT_SINGLE_MMAP;
+	if (singleMapping)
+	{
+		submitSize = completeSize = max(submitSize, completeSize);
+	}
+	size_t entriesSize = params.sq_entries * sizeof(io_uring_sqe);
+	char* submitRing = (char*)mmap(NULL, submitSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQ_RING);
+	char* completeRing = singleMapping ? submitRing
+		: (char*)mmap(NULL, completeSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_CQ_RING);
+	io_uring_sqe* entries = (io_uring_sqe*)mmap(NULL, entriesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQES);
+	if (submitRing == MAP_FAILED || completeRing == MAP_FAILED || entries == MAP_FAILED)
+	{
+		if (submitRing != MAP_FAILED)
+		{
+			munmap(submitRing, submitSize);
 		}
-		else if (current == "if" || current == "while")
+		if (!singleMapping && completeRing != MAP_FAILED)
 		{
-			vector<string> expression;
-			i += 2;
-			string next = tokens[i];
-			while (next != ")")
+			munmap(completeRing, completeSize);
+		}
+		if (entries != MAP_FAILED)
+		{
+			munmap(entries, entriesSize);
+		}
+		close(ring);
+		return false;
+	}
+	unsigned* submitTail = (unsigned*)(submitRing + params.sq_off.tail);
+	unsigned submitMask = *(unsigned*)(submitRing + params.sq_off.ring_mask);
+	unsigned* submitArray = (unsigned*)(submitRing + params.sq_off.array);
+	unsigned* completeHead = (unsigned*)(completeRing + params.cq_off.head);
+	unsigned* completeTail = (unsigned*)(completeRing + params.cq_off.tail);
+	unsigned completeMask = *(unsigned*)(completeRing + params.cq_off.ring_mask);
+	io_uring_cqe* completions = (io_uring_cqe*)(completeRing + params.cq_off.cqes);
+	
+	// each file being read has one operation in flight at a time: open, then statx for its size, then reads
+	enum {STAGE_OPEN, STAGE_STATX, STAGE_READ};
+	struct pendingRead
+	{
+		int file;
+		int stage;
+		struct statx info;
+		string text;
+		size_t done;
+	};
+	vector<pendingRead> reads(min<int>(READ_QUEUE_DEPTH, params.sq_entries));
+	vector<int> freeSlots;
+	for (int r = reads.size() - 1; r >= 0; r--)
+	{
+		freeSlots.push_back(r);
+	}
+	vector<int> readIndex(reads.size()); // the index of the file each slot is reading
+	unsigned tail = *submitTail;
+	int unsubmitted = 0;
+	
+	// the entry is filled in by the caller, and is submitted with the next io_uring_enter
+	auto queueEntry = [&](int slot) -> io_uring_sqe*
+	{
+		unsigned index = tail & submitMask;
+		io_uring_sqe* entry = &entries[index];
+		memset(entry, 0, sizeof(*entry));
+		entry->user_data = slot;
+		submitArray[index] = index;
+		tail++;
+		unsubmitted++;
+		return entry;
+	};
+	auto queueRead = [&](int slot)
+	{
+		pendingRead& pending = reads[slot];
+		io_uring_sqe* entry = queueEntry(slot);
+		entry->opcode = IORING_OP_READ;
+		entry->fd = pending.file;
+		entry->addr = (unsigned long long)&pending.text[pending.done];
+		entry->len = min<size_t>(pending.text.size() - pending.done, 1 << 30);
+		entry->off = pending.done;
+	};
+	// the file is finished with, so hand it over and start the next one in its slot
+	const int READ_AGAIN = -1;
+	auto finish = [&](int slot, int error) // the error number, 0 once read, or READ_AGAIN to read it the usual way
+	{
+		pendingRead& pending = reads[slot];
+		if (pending.file != -1)
+		{
+			close(pending.file);
+		}
+		if (error == READ_AGAIN)
+		{
+			error = readFile(fileNames[readIndex[slot]], &pending.text);
+		}
+		else if (error != 0)
+		{
+			pending.text.clear();
+		}
+		else
+		{
+			pending.text.resize(pending.done);
+		}
+		ready(readIndex[slot], &pending.text, error);
+		freeSlots.push_back(slot);
+	};
+	
+	int next = 0;
+	int inFlight = 0;
+	while (next < (int)fileNames.size() || inFlight > 0)
+	{
+		while (next < (int)fileNames.size() && !freeSlots.empty())
+		{
+			int slot = freeSlots.back();
+			freeSlots.pop_back();
+			pendingRead& pending = reads[slot];
+			pending.file = -1;
+			pending.stage = STAGE_OPEN;
+			pending.done = 0;
+			readIndex[slot] = next;
+			io_uring_sqe* entry = queueEntry(slot);
+			entry->opcode = IORING_OP_OPENAT;
+			entry->fd = AT_FDCWD;
+			entry->addr = (unsigned long long)fileNames[next].c_str();
+			entry->open_flags = O_RDONLY | O_CLOEXEC;
+			next++;
+			inFlight++;
+		}
+		
+		__atomic_store_n(submitTail, tail, __ATOMIC_RELEASE);
+		int submitted = syscall(__NR_io_uring_enter, ring, unsubmitted, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+		if (submitted < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY)
+		{
+			break; // the ring is unusable, so the files left are read below
+		}
+		unsubmitted -= max(submitted, 0);
+		
+		unsigned head = *completeHead;
+		while (head != __atomic_load_n(completeTail, __ATOMIC_ACQUIRE))
+		{
+			io_uring_cqe* completion = &completions[head & completeMask];
+			int slot = completion->user_data;
+			int result = completion->res;
+			head++;
+			__atomic_store_n(completeHead, head, __ATOMIC_RELEASE);
+			
+			pendingRead& pending = reads[slot];
+			if (result < 0)
 			{
-				expression.push_back(next);
-				i++;
-				next = tokens[i];
+				// a failed read is the file's error, while an open or statx the kernel rejects may still work as a read
+				finish(slot, pending.stage == STAGE_READ ? -result : READ_AGAIN);
+				inFlight--;
 			}
-			string loopCondition = parseExpression(expression);
-			
-			if (loopCondition == "e")
+			else if (pending.stage == STAGE_OPEN)
 			{
-				return;
+				pending.file = result;
+				pending.stage = STAGE_STATX;
+				io_uring_sqe* entry = queueEntry(slot);
+				entry->opcode = IORING_OP_STATX;
+				entry->fd = pending.file;
+				entry->addr = (unsigned long long)"";
+				entry->len = STATX_SIZE | STATX_TYPE;
+				entry->statx_flags = AT_EMPTY_PATH;
+				entry->off = (unsigned long long)&pending.info;
 			}
-			else if (loopCondition != "bool")
+			else if (pending.stage == STAGE_STATX)
 			{
-				if (current == "if")
+				if (!S_ISREG(pending.info.stx_mode) || pending.info.stx_size == 0)
 				{
-					showError(10);
+					finish(slot, READ_AGAIN); // its size is not known ahead, so it is read until it ends instead
+					inFlight--;
+					continue;
+				}
+				pending.stage = STAGE_READ;
+				pending.text.resize(pending.info.stx_size);
+				queueRead(slot);
+			}
+			else
+			{
+				pending.done += result;
+				if (pending.done == pending.text.size())
+				{
+					finish(slot, 0);
+					inFlight--;
+				}
+				else if (result == 0) // the file shrank or was replaced, so what is there now is read, if anything
+				{
+					finish(slot, READ_AGAIN);
+					inFlight--;
 				}
 				else
 				{
-					showError(11);
+					queueRead(slot);
 				}
-				return;
 			}
 		}
 	}
-	cout << "No type checking errors found.";
+	
+	munmap(entries, entriesSize);
+	if (!singleMapping)
+	{
+		munmap(completeRing, completeSize);
+	}
+	munmap(submitRing, submitSize);
+	close(ring);
+	
+	if (inFlight > 0 || next < (int)fileNames.size()) // the ring failed part way through
+	{
+		// the kernel may still write to the buffers of reads in flight, so they are left allocated
+		vector<pendingRead>* abandoned = new vector<pendingRead>();
+		abandoned->swap(reads);
+		for (size_t r = 0; r < abandoned->size(); r++)
+		{
+			if (find(freeSlots.begin(), freeSlots.end(), r) == freeSlots.end())
+			{
+				string text;
+				int error = readFile(fileNames[readIndex[r]], &text);
+				ready(readIndex[r], &text, error);
+			}
+		}
+		for (string text; next < (int)fileNames.size(); next++)
+		{
+			int error = readFile(fileNames[next], &text);
+			ready(next, &text, error);
+		}
+	}
+	return true;
+#else
+	return false;
+#endif
 }
 
-string parseExpression(vector<string> expression)
+void resetChecker()
 {
-	// This function goes through all the expression operators (and parentheses) in
-	// their appropriate evaluation order. It resolves each operator by removing all
-	// tokens used by the operator, then replaces the operator with a literal
-	// value of the operator's output type.
-	// ex. The sequence 4, <, 2 will have 4 and 2 removed, then < replaced with true.
-	// For literal pointers, * is attached to the appropriate literal value to denote it. 
-	int foundLoc = findFirst(expression, "(");
-	while (foundLoc != -1)
+	for (unordered_map<string, symbolInfo*>::iterator it = symbolTable.begin(); it != symbolTable.end(); it++)
 	{
-		vector<string> subExpr;
-		string current = expression[foundLoc + 1];
-		while (current != ")")
-		{
-			subExpr.push_back(current);
-			expression.erase(expression.begin() + foundLoc + 1);
-			current = expression[foundLoc + 1];
-		}
-		
-		string subExprType = parseExpression(subExpr);
-		if (subExprType == "e")
+		delete it->second;
+	}
+	symbolTable.clear();
+	declarationLog.clear();
+	checkpoints.clear();
+	exportedNames.clear();
+	lineStarts.clear();
+	currentFunc = "";
+	fileScope = 0;
+	errorOffset = 0;
+	argumentsEnd = 0;
+}
+
+void restoreCheckpoint(const checkpoint& point)
+{
+	while ((int)declarationLog.size() > point.declarations)
+	{
+		unordered_map<string, symbolInfo*>::iterator it = symbolTable.find(declarationLog.back());
+		delete it->second;
+		symbolTable.erase(it);
+		declarationLog.pop_back();
+	}
+	exportedNames.resize(point.exports);
+	currentFunc = point.function;
+	argumentsEnd = point.argumentsEnd;
+	fileScope = 0;
+}
+
+int watchFiles(const vector<string>& paths)
+{
+#ifdef __linux__
+	int watcher = inotify_init();
+	if (watcher == -1)
+	{
+		cout << "Could not start watching for changes." << endl;
+		return 1;
+	}
+	
+	// editors often save by replacing the file, so the directories are watched rather than the files
+	vector<watchedFile*> files;
+	unordered_map<int, string> watchedDirectories;
+	unordered_set<string> wholeDirectories; // directories passed as arguments, where any .cs file is checked
+	for (size_t p = 0; p < paths.size(); p++)
+	{
+		string directory = paths[p];
+		struct stat status;
+		if (stat(paths[p].c_str(), &status) == 0 && S_ISDIR(status.st_mode))
 		{
-			return "e";
+			if (directory[directory.size() - 1] != '/')
+			{
+				directory += '/';
+			}
+			wholeDirectories.insert(directory);
+			DIR* listing = opendir(directory.c_str());
+			if (listing == NULL)
+			{
+				cout << "Could not read the directory " << directory << "." << endl;
+				close(watcher);
+				return 1;
+			}
+			for (dirent* entry = readdir(listing); entry != NULL; entry = readdir(listing))
+			{
+				string name = entry->d_name;
+				if (name.size() > 3 && name.compare(name.size() - 3, 3, ".cs") == 0)
+				{
+					files.push_back(new watchedFile());
+					files.back()->fileName = directory + name;
+				}
+			}
+			closedir(listing);
 		}
-		
-		string pointerAdd;
-		string dummyValue;
-		if (subExprType[0] == '*')
+		else
 		{
-			pointerAdd = "*";
-			subExprType = subExprType.substr(1, subExprType.size());
+			size_t slash = directory.rfind('/');
+			directory = slash == string::npos ? "" : directory.substr(0, slash + 1);
+			files.push_back(new watchedFile());
+			files.back()->fileName = paths[p];
 		}
-		
-		if (subExprType == "char")
+		int watch = inotify_add_watch(watcher, directory == "" ? "." : directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+		if (watch == -1)
 		{
-			dummyValue = "\'";
+			cout << "Could not watch the directory " << (directory == "" ? "." : directory) << " for changes." << endl;
+			close(watcher);
+			return 1;
 		}
-		else if (subExprType == "int")
+		watchedDirectories[watch] = directory;
+	}
+	
+	for (size_t f = 0; f < files.size(); f++)
+	{
+		checkWatchedFile(files[f], true);
+	}
+	
+	char events[64 * (sizeof(inotify_event) + 256)];
+	while (true)
+	{
+		int length = read(watcher, events, sizeof(events));
+		if (length <= 0)
 		{
-			dummyValue = "0";
+			break;
 		}
-		else if (subExprType == "string")
+		// a save can produce several events, so each changed file is checked once per read
+		unordered_set<string> changed;
+		for (char* position = events; position < events + length; )
 		{
-			dummyValue = "\"";
+			inotify_event* event = (inotify_event*)position;
+			position += sizeof(inotify_event) + event->len;
+			if (event->len > 0)
+			{
+				changed.insert(watchedDirectories[event->wd] + event->name);
+			}
 		}
-		else if (subExprType == "bool")
+		for (unordered_set<string>::iterator it = changed.begin(); it != changed.end(); it++)
 		{
-			dummyValue = "true";
+			bool found = false;
+			for (size_t f = 0; f < files.size(); f++)
+			{
+				if (files[f]->fileName == *it)
+				{
+					checkWatchedFile(files[f], false);
+					found = true;
+				}
+			}
+			size_t slash = it->rfind('/');
+			string directory = slash == string::npos ? "" : it->substr(0, slash + 1);
+			if (!found && wholeDirectories.count(directory) > 0 && it->size() > 3 && it->compare(it->size() - 3, 3, ".cs") == 0)
+			{
+				files.push_back(new watchedFile());
+				files.back()->fileName = *it;
+				checkWatchedFile(files.back(), true);
+			}
 		}
-		expression[foundLoc] = pointerAdd + dummyValue;
-		expression.erase(expression.begin() + foundLoc + 1); // erasing ")"
-		
-		foundLoc = findFirst(expression, "(");
 	}
+	close(watcher);
+	return 0;
+#else
+	cout << "Watch mode needs inotify, which this system does not have." << endl;
+	return 1;
+#endif
+}
+
+void checkWatchedFile(watchedFile* file, bool full)
+{
+	chrono::steady_clock::time_point started = chrono::steady_clock::now();
+	size_t slash = file->fileName.find_last_of("/\\");
+	moduleDirectory = file->fileName.substr(0, slash == string::npos ? 0 : slash + 1); // imports are found beside it
+	readSource(file->fileName);
+	string text;
+	text.swap(sourceText);
+	if (checkFileText(file, &text, full))
+	{
+		double elapsed = chrono::duration<double, milli>(chrono::steady_clock::now() - started).count();
+		cout << file->fileName << ": " << file->output << endl;
+		cout << "(checked in " << fixed << setprecision(2) << elapsed << " ms)" << endl;
+	}
+}
+
+bool checkFileText(watchedFile* file, string* text, bool full)
+{
+	swapFileState(file);
 	
-	foundLoc = findFirst(expression, "[");
-	while (foundLoc != -1)
+	int resumeAt = LEADING_PADDING;
+	string previousText; // put back if the check is cancelled
+	previousText.swap(sourceText);
+	sourceText.swap(*text);
+	if (full || file->tokens.empty())
 	{
-		if (tokenType(&expression[foundLoc - 1]) != "string")
-		{
-			showError(13);
-			return "e";
-		}
-		
-		vector<string> subExpr;
-		string current = expression[foundLoc + 1];
-		while (current != "]")
+		resetChecker();
+		file->tokens.clear();
+		file->offsets.clear();
+		addPadding(&file->tokens, &file->offsets, false);
+		lexSource(&file->tokens, &file->offsets, 0, -1);
+		addPadding(&file->tokens, &file->offsets, true);
+	}
+	else
+	{
+		int firstChange = relexChanges(previousText, &file->tokens, &file->offsets);
+		if (firstChange == -1) // saved without changes
 		{
-			subExpr.push_back(current);
-			expression.erase(expression.begin() + foundLoc + 1);
-			current = expression[foundLoc + 1];
+			swapFileState(file);
+			return false;
 		}
 		
-		string expressionType = parseExpression(subExpr);
-		if (expressionType == "e")
+		// resume from the last top-level unit that starts before the change
+		int point = checkpoints.size() - 1;
+		while (point > 0 && checkpoints[point].tokenIndex > firstChange)
 		{
-			return "e";
+			point--;
 		}
-		else if (expressionType != "int")
+		checkpoint resume = checkpoints[point];
+		restoreCheckpoint(resume);
+		checkpoints.resize(point);
+		resumeAt = resume.tokenIndex;
+	}
+	text->clear();
+	
+	ostringstream output;
+	diagnostics = &output;
+	bool passed = typeCheck(file->tokens, file->offsets, resumeAt);
+	diagnostics = &cout;
+	bool cancelled = !passed && cancelCheck != NULL && cancelCheck->load();
+	if (cancelled) // keep the last finished result, and check the text from scratch next time
+	{
+		sourceText.swap(previousText);
+		file->tokens.clear();
+		file->offsets.clear();
+		swapFileState(file);
+		return false;
+	}
+	file->output = output.str();
+	file->errorCode = passed ? 0 : lastError;
+	file->errorLine = 0;
+	file->errorColumn = 0;
+	file->errorLength = 0;
+	if (!passed)
+	{
+		findLocation(errorOffset, &file->errorLine, &file->errorColumn);
+		file->errorLine--;
+		file->errorColumn--;
+		int token = lower_bound(file->offsets.begin(), file->offsets.end() - TRAILING_PADDING, errorOffset) - file->offsets.begin();
+		file->errorLength = max<int>(file->tokens[token].size(), 1);
+	}
+	swapFileState(file);
+	return true;
+}
+
+void swapFileState(watchedFile* file)
+{
+	sourceText.swap(file->source);
+	symbolTable.swap(file->symbols);
+	declarationLog.swap(file->declarations);
+	exportedNames.swap(file->exports);
+	checkpoints.swap(file->checkpoints);
+	lineStarts.clear();
+}
+
+int runServer()
+{
+#ifndef _WIN32
+	unordered_map<string, openDocument*> documents;
+	mutex lock; // guards the queue and each document's checkPending and checkDue
+	condition_variable wake;
+	vector<openDocument*> queue; // documents waiting to be checked
+	openDocument* checking = NULL; // the document being checked
+	bool stopping = false;
+	bool utf16 = true; // whether positions are counted in UTF-16 code units rather than bytes
+	
+	// the checking thread takes a copy of a document's text, so the reading thread can keep applying edits
+	thread checker([&]()
+	{
+		unique_lock<mutex> guard(lock);
+		while (true)
 		{
-			showError(12);
-			return "e";
+			wake.wait(guard, [&]() {return stopping || !queue.empty();});
+			if (stopping)
+			{
+				return;
+			}
+			openDocument* document = queue.front();
+			queue.erase(queue.begin());
+			string text = document->text;
+			int version = document->version;
+			chrono::steady_clock::time_point lastChange = document->lastChange;
+			document->cancel = false;
+			checking = document;
+			guard.unlock();
+			
+			cancelCheck = &document->cancel;
+			moduleDirectory = uriDirectory(document->uri); // imports are found beside the document, as in watch mode
+			bool checked = checkFileText(&document->state, &text, false);
+			bool cancelled = document->cancel.load();
+			if (!checked && !cancelled && document->state.tokens.size() > 0) // unchanged, so publish the last result again
+			{
+				checked = true;
+			}
+			if (checked && !cancelled)
+			{
+				double latency = chrono::duration<double, milli>(chrono::steady_clock::now() - lastChange).count();
+				publishDiagnostics(document, version, latency, utf16);
+			}
+			
+			guard.lock();
+			checking = NULL;
 		}
-		
-		expression[foundLoc] = "\'";
-		expression.erase(expression.begin() + foundLoc + 1); // erasing "]"
-		expression.erase(expression.begin() + foundLoc - 1); // erasing string id
-		
-		foundLoc = findFirst(expression, "[");
-	}
+	});
 	
-	foundLoc = findFirst(expression, "|");
-	while (foundLoc != -1)
+	int exitCode = 1;
+	bool running = true;
+	while (running)
 	{
-		vector<string> subExpr;
-		string current = expression[foundLoc + 1];
-		while (current != "|")
+		// wait for the next message, or until the next pending check is due
+		int timeout = -1;
+		chrono::steady_clock::time_point now = chrono::steady_clock::now();
 		{
-			subExpr.push_back(current);
-			expression.erase(expression.begin() + foundLoc + 1);
-			current = expression[foundLoc + 1];
+			lock_guard<mutex> guard(lock);
+			for (unordered_map<string, openDocument*>::iterator it = documents.begin(); it != documents.end(); it++)
+			{
+				openDocument* document = it->second;
+				if (document->checkPending && document->checkDue <= now && document != checking)
+				{
+					document->checkPending = false;
+					queue.push_back(document);
+					wake.notify_one();
+				}
+				else if (document->checkPending)
+				{
+					int wait = max<int>(1, chrono::duration_cast<chrono::milliseconds>(document->checkDue - now).count());
+					timeout = timeout == -1 ? wait : min(timeout, wait);
+				}
+			}
 		}
 		
-		string subExprType = parseExpression(subExpr);
-		if (subExprType == "e")
+		string body;
+		int status = readMessage(&body, timeout);
+		if (status == -1) // input closed without an exit notification
 		{
-			return "e";
+			exitCode = 1;
+			break;
 		}
-		else if (subExprType != "int")
+		if (status == 0)
 		{
-			showError(15);
-			return "e";
+			continue;
 		}
-		expression[foundLoc] = "0";
-		expression.erase(expression.begin() + foundLoc + 1); // erasing closing "|"
 		
-		foundLoc = findFirst(expression, "|");
-	}
-	
-	foundLoc = findFirst(expression, "&");
-	while (foundLoc != -1)
-	{
-		if (tokenType(&expression[foundLoc + 1]) == "int")
+		jsonValue message;
+		size_t position = 0;
+		if (!parseJson(body, &position, &message) || message.kind != jsonValue::JSON_OBJECT)
 		{
-			expression[foundLoc] = "*0";
-			expression.erase(expression.begin() + foundLoc + 1);
+			continue;
 		}
-		else if (tokenType(&expression[foundLoc + 1]) == "char") // indexed strings just evaluate to char
+		string method = message.get("method").text;
+		const jsonValue& id = message.get("id");
+		const jsonValue& params = message.get("params");
+		
+		if (method == "initialize")
 		{
-			expression[foundLoc] = "*\'";
-			expression.erase(expression.begin() + foundLoc + 1);
+			const jsonValue& encodings = params.get("capabilities").get("general").get("positionEncodings");
+			for (size_t e = 0; e < encodings.items.size(); e++)
+			{
+				if (encodings.items[e].text == "utf-8")
+				{
+					utf16 = false;
+				}
+			}
+			sendMessage("{\"jsonrpc\":\"2.0\",\"id\":" + jsonId(id) + ",\"result\":{\"capabilities\":"
+				"{\"positionEncoding\":" + string(utf16 ? "\"utf-16\"" : "\"utf-8\"") + ","
+				"\"textDocumentSync\":{\"openClose\":true,\"change\":2}},\"serverInfo\":{\"name\":\"csimple-type-checker\"}}}");
 		}
-		else
+		else if (method == "shutdown")
 		{
-			showError(17);
-			return "e";
+			exitCode = 0;
+			sendMessage("{\"jsonrpc\":\"2.0\",\"id\":" + jsonId(id) + ",\"result\":null}");
 		}
-		
-		foundLoc = findFirst(expression, "&");
-	}
-	
-	foundLoc = findFirst(expression, "^");
-	while (foundLoc != -1)
-	{
-		if (tokenType(&expression[foundLoc + 1]) == "*int")
+		else if (method == "exit")
 		{
-			expression[foundLoc] = "0";
-			expression.erase(expression.begin() + foundLoc + 1);
+			running = false;
 		}
-		else if (tokenType(&expression[foundLoc + 1]) == "*char")
+		else if (method == "textDocument/didOpen" || method == "textDocument/didChange" || method == "textDocument/didClose")
 		{
-			expression[foundLoc] = "\'";
-			expression.erase(expression.begin() + foundLoc + 1);
+			const jsonValue& textDocument = params.get("textDocument");
+			string uri = textDocument.get("uri").text;
+			lock_guard<mutex> guard(lock);
+			unordered_map<string, openDocument*>::iterator it = documents.find(uri);
+			if (it == documents.end())
+			{
+				openDocument* document = new openDocument();
+				document->uri = uri;
+				document->state.fileName = uri;
+				document->version = 0;
+				document->checkPending = false;
+				document->cancel = false;
+				it = documents.insert(pair<string, openDocument*>(uri, document)).first;
+			}
+			openDocument* document = it->second;
+			
+			if (method == "textDocument/didOpen")
+			{
+				document->text = textDocument.get("text").text;
+				document->open = true;
+			}
+			else if (method == "textDocument/didChange")
+			{
+				const jsonValue& changes = params.get("contentChanges");
+				for (size_t c = 0; c < changes.items.size(); c++)
+				{
+					applyChange(&document->text, changes.items[c], utf16);
+				}
+			}
+			else
+			{
+				document->open = false;
+				document->checkPending = false;
+				vector<openDocument*>::iterator queued = find(queue.begin(), queue.end(), document);
+				if (queued != queue.end())
+				{
+					queue.erase(queued);
+				}
+				if (document == checking)
+				{
+					document->cancel = true;
+				}
+				sendMessage("{\"jsonrpc\":\"2.0\",\"method\":\"textDocument/publishDiagnostics\",\"params\":{\"uri\":"
+					+ jsonString(uri) + ",\"diagnostics\":[]}}");
+				continue;
+			}
+			
+			if (textDocument.get("version").kind == jsonValue::JSON_NUMBER)
+			{
+				document->version = textDocument.get("version").number;
+			}
+			document->lastChange = chrono::steady_clock::now();
+			document->checkDue = document->lastChange + chrono::milliseconds(SERVER_DEBOUNCE_MS);
+			document->checkPending = true;
+			if (document == checking) // its result is already stale
+			{
+				document->cancel = true;
+			}
 		}
-		else
+		else if (id.kind != jsonValue::JSON_NULL) // a request the server does not support
 		{
-			showError(18);
-			return "e";
+			sendMessage("{\"jsonrpc\":\"2.0\",\"id\":" + jsonId(id) + ",\"error\":{\"code\":-32601,\"message\":\"Method not found\"}}");
 		}
-		
-		foundLoc = findFirst(expression, "^");
 	}
 	
-	foundLoc = findFirst(expression, "!");
-	while (foundLoc != -1)
 	{
-		if (tokenType(&expression[foundLoc + 1]) == "bool")
+		lock_guard<mutex> guard(lock);
+		stopping = true;
+		if (checking != NULL)
 		{
-			expression[foundLoc] = "true";
-			expression.erase(expression.begin() + foundLoc + 1);
+			checking->cancel = true;
 		}
-		else
+	}
+	wake.notify_one();
+	checker.join();
+	return exitCode;
+#else
+	cout << "Server mode is not supported on this system." << endl;
+	return 1;
+#endif
+}
+
+int readMessage(string* body, int timeout)
+{
+#ifndef _WIN32
+	static string buffer; // input read past the end of the previous message
+	chrono::steady_clock::time_point deadline = chrono::steady_clock::now() + chrono::milliseconds(timeout);
+	while (true)
+	{
+		size_t headerEnd = buffer.find("\r\n\r\n");
+		if (headerEnd != string::npos)
 		{
-			showError(15);
-			return "e";
+			size_t lengthAt = buffer.find("Content-Length:");
+			int length = lengthAt < headerEnd ? atoi(buffer.c_str() + lengthAt + 15) : 0;
+			if (buffer.size() >= headerEnd + 4 + length)
+			{
+				body->assign(buffer, headerEnd + 4, length);
+				buffer.erase(0, headerEnd + 4 + length);
+				return 1;
+			}
 		}
 		
-		foundLoc = findFirst(expression, "!");
-	}
-	
-	foundLoc = findFirst(expression, "*");
-	while (foundLoc != -1)
-	{
-		string leftToken = tokenType(&expression[foundLoc - 1]);
-		string rightToken = tokenType(&expression[foundLoc + 1]);
-		if (leftToken == "int" && rightToken == "int")
+		int wait = timeout;
+		if (timeout != -1)
 		{
-			expression[foundLoc] = "0";
-			expression.erase(expression.begin() + foundLoc + 1);
-			expression.erase(expression.begin() + foundLoc - 1);
+			wait = max<int>(0, chrono::duration_cast<chrono::milliseconds>(deadline - chrono::steady_clock::now()).count());
 		}
-		else if (leftToken[0] == '*' || rightToken[0] == '*')
+		pollfd input = {0, POLLIN, 0};
+		if (poll(&input, 1, wait) == 0)
 		{
-			showError(16);
-			return "e";
+			return 0;
 		}
-		else
+		char chunk[65536];
+		int length = read(0, chunk, sizeof(chunk));
+		if (length <= 0)
 		{
-			showError(15);
-			return "e";
+			return -1;
 		}
-		
-		foundLoc = findFirst(expression, "*");
+		buffer.append(chunk, length);
 	}
-	
-	foundLoc = findFirst(expression, "/");
-	while (foundLoc != -1)
+#else
+	return -1;
+#endif
+}
+
+void sendMessage(const string& body)
+{
+	static mutex writing;
+	lock_guard<mutex> guard(writing);
+	cout << "Content-Length: " << body.size() << "\r\n\r\n" << body << flush;
+}
+
+void publishDiagnostics(openDocument* document, int version, double latency, bool utf16)
+{
+	const watchedFile& state = document->state;
+	string diagnostic;
+	if (state.errorCode != 0)
 	{
-		string leftToken = tokenType(&expression[foundLoc - 1]);
-		string rightToken = tokenType(&expression[foundLoc + 1]);
-		if (leftToken == "int" && rightToken == "int")
+		size_t start = state.errorColumn;
+		size_t end = state.errorColumn + state.errorLength;
+		if (utf16)
 		{
-			expression[foundLoc] = "0";
-			expression.erase(expression.begin() + foundLoc + 1);
-			expression.erase(expression.begin() + foundLoc - 1);
+			size_t lineStart = 0;
+			for (int l = 0; l < state.errorLine && lineStart != string::npos; l++)
+			{
+				lineStart = state.source.find('\n', lineStart);
+				lineStart = lineStart == string::npos ? string::npos : lineStart + 1;
+			}
+			if (lineStart != string::npos)
+			{
+				start = convertColumn(state.source, lineStart, start, false);
+				end = convertColumn(state.source, lineStart, end, false);
+			}
 		}
-		else if (leftToken[0] == '*' || rightToken[0] == '*')
+		ostringstream range;
+		range << "{\"start\":{\"line\":" << state.errorLine << ",\"character\":" << start
+			<< "},\"end\":{\"line\":" << state.errorLine << ",\"character\":" << end << "}}";
+		ostringstream code;
+		code << state.errorCode;
+		diagnostic = "{\"range\":" + range.str() + ",\"severity\":1,\"code\":" + code.str()
+			+ ",\"source\":\"csimple\",\"message\":" + jsonString(errorMessage(state.errorCode)) + "}";
+	}
+	ostringstream versionText;
+	versionText << version;
+	sendMessage("{\"jsonrpc\":\"2.0\",\"method\":\"textDocument/publishDiagnostics\",\"params\":{\"uri\":"
+		+ jsonString(document->uri) + ",\"version\":" + versionText.str() + ",\"diagnostics\":[" + diagnostic + "]}}");
+	
+	// the time from the last edit to the diagnostics being sent, so latency can be measured from the client's log
+	ostringstream log;
+	log << "checked " << document->uri << " version " << version << ", " << fixed << setprecision(2) << latency
+		<< " ms after the last change (" << SERVER_DEBOUNCE_MS << " ms of it waiting for typing to pause)";
+	sendMessage("{\"jsonrpc\":\"2.0\",\"method\":\"window/logMessage\",\"params\":{\"type\":4,\"message\":" + jsonString(log.str()) + "}}");
+}
+
+void applyChange(string* text, const jsonValue& change, bool utf16)
+{
+	const jsonValue& range = change.get("range");
+	const string& newText = change.get("text").text;
+	if (range.kind != jsonValue::JSON_OBJECT) // the whole document was replaced
+	{
+		*text = newText;
+		return;
+	}
+	
+	size_t offsets[2];
+	const char* ends[2] = {"start", "end"};
+	for (int e = 0; e < 2; e++)
+	{
+		const jsonValue& position = range.get(ends[e]);
+		int line = position.get("line").number;
+		size_t offset = 0;
+		for (int l = 0; l < line && offset != string::npos; l++)
 		{
-			showError(16);
-			return "e";
+			offset = text->find('\n', offset);
+			offset = offset == string::npos ? string::npos : offset + 1;
 		}
-		else
+		if (offset == string::npos)
 		{
-			showError(15);
-			return "e";
+			offsets[e] = text->size();
+			continue;
 		}
-		
-		foundLoc = findFirst(expression, "/");
+		size_t character = max(position.get("character").number, 0.0);
+		offsets[e] = min(offset + (utf16 ? convertColumn(*text, offset, character, true) : character), text->size());
+	}
+	if (offsets[1] < offsets[0])
+	{
+		swap(offsets[0], offsets[1]);
+	}
+	text->replace(offsets[0], offsets[1] - offsets[0], newText);
+}
+
+size_t convertColumn(const string& text, size_t lineStart, size_t column, bool toBytes)
+{
+	// each UTF-8 lead byte starts one code point, which is two UTF-16 code units if it takes four bytes
+	size_t bytes = 0;
+	size_t units = 0;
+	while (lineStart + bytes < text.size() && text[lineStart + bytes] != '\n' && (toBytes ? units : bytes) < column)
+	{
+		unsigned char lead = text[lineStart + bytes];
+		size_t length = lead < 0xC0 ? 1 : lead < 0xE0 ? 2 : lead < 0xF0 ? 3 : 4;
+		bytes += min(length, text.size() - lineStart - bytes);
+		units += length == 4 ? 2 : 1;
+	}
+	return toBytes ? bytes : units;
+}
+
+bool parseJson(const string& text, size_t* position, jsonValue* value)
+{
+	size_t& at = *position;
+	while (at < text.size() && isspace((unsigned char)text[at]))
+	{
+		at++;
+	}
+	if (at >= text.size())
+	{
+		return false;
 	}
 	
-	foundLoc = findFirst(expression, "+");
-	while (foundLoc != -1)
+	char first = text[at];
+	if (first == '{' || first == '[')
 	{
-		string leftToken = tokenType(&expression[foundLoc - 1]);
-		string rightToken = tokenType(&expression[foundLoc + 1]);
-		if (leftToken == "int" && rightToken == "int")
+		value->kind = first == '{' ? jsonValue::JSON_OBJECT : jsonValue::JSON_ARRAY;
+		char close = first == '{' ? '}' : ']';
+		at++;
+		while (true)
 		{
-			expression[foundLoc] = "0";
-			expression.erase(expression.begin() + foundLoc + 1);
-			expression.erase(expression.begin() + foundLoc - 1);
-		}
-		else if ((leftToken[0] == '*' && rightToken == "int")
-		|| (leftToken == "int" && rightToken[0] == '*'))
-		{
-			string dummyValue;
-			string pointerType;
-			if (leftToken[0] == '*')
+			while (at < text.size() && isspace((unsigned char)text[at]))
 			{
-				pointerType = leftToken.substr(1, leftToken.size());
+				at++;
 			}
-			else // right token is the pointer
+			if (at < text.size() && text[at] == close)
 			{
-				pointerType = rightToken.substr(1, rightToken.size());
+				at++;
+				return true;
 			}
-			
-			if (pointerType == "char")
+			jsonValue item;
+			if (first == '{')
+			{
+				jsonValue name;
+				if (!parseJson(text, position, &name) || name.kind != jsonValue::JSON_STRING)
+				{
+					return false;
+				}
+				while (at < text.size() && isspace((unsigned char)text[at]))
+				{
+					at++;
+				}
+				if (at >= text.size() || text[at] != ':')
+				{
+					return false;
+				}
+				at++;
+				if (!parseJson(text, position, &item))
+				{
+					return false;
+				}
+				value->members.push_back(pair<string, jsonValue>(name.text, item));
+			}
+			else
 			{
-				dummyValue = "\'";
+				if (!parseJson(text, position, &item))
+				{
+					return false;
+				}
+				value->items.push_back(item);
 			}
-			else if (pointerType == "int")
+			while (at < text.size() && isspace((unsigned char)text[at]))
 			{
-				dummyValue = "0";
+				at++;
 			}
-			else if (pointerType == "string")
+			if (at < text.size() && text[at] == ',')
 			{
-				dummyValue = "\"";
+				at++;
 			}
-			else if (pointerType == "bool")
+			else if (at >= text.size() || text[at] != close)
 			{
-				dummyValue = "true";
+				return false;
 			}
-			expression[foundLoc] = "*" + dummyValue;
-			expression.erase(expression.begin() + foundLoc + 1);
-			expression.erase(expression.begin() + foundLoc - 1);
-		}
-		else
-		{
-			showError(15);
-			return "e";
 		}
-		
-		foundLoc = findFirst(expression, "+");
 	}
-	
-	foundLoc = findFirst(expression, "-");
-	while (foundLoc != -1)
+	else if (first == '"')
 	{
-		string leftToken = tokenType(&expression[foundLoc - 1]);
-		string rightToken = tokenType(&expression[foundLoc + 1]);
-		if (leftToken == "int" && rightToken == "int")
-		{
-			expression[foundLoc] = "0";
-			expression.erase(expression.begin() + foundLoc + 1);
-			expression.erase(expression.begin() + foundLoc - 1);
-		}
-		else if (leftToken[0] == '*' && rightToken == "int")
+		value->kind = jsonValue::JSON_STRING;
+		at++;
+		while (at < text.size() && text[at] != '"')
 		{
-			string dummyValue;
-			string pointerType = leftToken.substr(1, leftToken.size());
-			
-			if (pointerType == "char")
+			char current = text[at++];
+			if (current != '\\')
 			{
-				dummyValue = "\'";
+				value->text += current;
+				continue;
 			}
-			else if (pointerType == "int")
+			if (at >= text.size())
 			{
-				dummyValue = "0";
-			}
-			else if (pointerType == "string")
-			{
-				dummyValue = "\"";
+				return false;
 			}
-			else if (pointerType == "bool")
+			char escaped = text[at++];
+			switch (escaped)
 			{
-				dummyValue = "true";
+				case 'b':
+					value->text += '\b';
+					break;
+				case 'f':
+					value->text += '\f';
+					break;
+				case 'n':
+					value->text += '\n';
+					break;
+				case 'r':
+					value->text += '\r';
+					break;
+				case 't':
+					value->text += '\t';
+					break;
+				case 'u':
+				{
+					if (at + 4 > text.size())
+					{
+						return false;
+					}
+					unsigned int code = strtoul(text.substr(at, 4).c_str(), NULL, 16);
+					at += 4;
+					if (code >= 0xD800 && code < 0xDC00 && at + 6 <= text.size() && text[at] == '\\' && text[at + 1] == 'u') // surrogate pair
+					{
+						unsigned int low = strtoul(text.substr(at + 2, 4).c_str(), NULL, 16);
+						code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+						at += 6;
+					}
+					// encoded as UTF-8
+					if (code < 0x80)
+					{
+						value->text += (char)code;
+					}
+					else if (code < 0x800)
+					{
+						value->text += (char)(0xC0 | (code >> 6));
+						value->text += (char)(0x80 | (code & 0x3F));
+					}
+					else if (code < 0x10000)
+					{
+						value->text += (char)(0xE0 | (code >> 12));
+						value->text += (char)(0x80 | ((code >> 6) & 0x3F));
+						value->text += (char)(0x80 | (code & 0x3F));
+					}
+					else
+					{
+						value->text += (char)(0xF0 | (code >> 18));
+						value->text += (char)(0x80 | ((code >> 12) & 0x3F));
+						value->text += (char)(0x80 | ((code >> 6) & 0x3F));
+						value->text += (char)(0x80 | (code & 0x3F));
+					}
+					break;
+				}
+				default: // ", \ and /
+					value->text += escaped;
+					break;
 			}
-			expression[foundLoc] = "*" + dummyValue;
-			expression.erase(expression.begin() + foundLoc + 1);
-			expression.erase(expression.begin() + foundLoc - 1);
 		}
-		else
+		if (at >= text.size())
 		{
-			showError(15);
-			return "e";
+			return false;
 		}
-		
-		foundLoc = findFirst(expression, "-");
+		at++; // closing "
+		return true;
+	}
+	else if (text.compare(at, 4, "true") == 0 || text.compare(at, 5, "false") == 0)
+	{
+		value->kind = jsonValue::JSON_BOOL;
+		value->boolean = first == 't';
+		at += value->boolean ? 4 : 5;
+		return true;
+	}
+	else if (text.compare(at, 4, "null") == 0)
+	{
+		value->kind = jsonValue::JSON_NULL;
+		at += 4;
+		return true;
 	}
 	
-	foundLoc = findFirst(expression, "<");
-	while (foundLoc != -1)
+	const char* start = text.c_str() + at;
+	char* end;
+	value->number = strtod(start, &end);
+	if (end == start)
 	{
-		if (tokenType(&expression[foundLoc - 1]) == "int" && tokenType(&expression[foundLoc + 1]) == "int")
-		{
-			expression[foundLoc] = "true";
-			expression.erase(expression.begin() + foundLoc + 1);
-			expression.erase(expression.begin() + foundLoc - 1);
-		}
-		else
+		return false;
+	}
+	value->kind = jsonValue::JSON_NUMBER;
+	value->text.assign(start, end - start);
+	at += end - start;
+	return true;
+}
+
+string jsonString(const string& text)
+{
+	string quoted = "\"";
+	for (size_t i = 0; i < text.size(); i++)
+	{
+		unsigned char current = text[i];
+		if (current == '"' || current == '\\')
 		{
-			showError(15);
-			return "e";
+			quoted += '\\';
+			quoted += current;
 		}
-		
-		foundLoc = findFirst(expression, "<");
-	}
-	
-	foundLoc = findFirst(expression, ">");
-	while (foundLoc != -1)
-	{
-		if (tokenType(&expression[foundLoc - 1]) == "int" && tokenType(&expression[foundLoc + 1]) == "int")
+		else if (current < 0x20)
 		{
-			expression[foundLoc] = "true";
-			expression.erase(expression.begin() + foundLoc + 1);
-			expression.erase(expression.begin() + foundLoc - 1);
+			char escaped[8];
+			snprintf(escaped, sizeof(escaped), "\\u%04x", current);
+			quoted += escaped;
 		}
 		else
 		{
-			showError(15);
-			return "e";
+			quoted += current;
 		}
-		
-		foundLoc = findFirst(expression, ">");
 	}
-	
-	foundLoc = findFirst(expression, "<=");
-	while (foundLoc != -1)
+	return quoted + "\"";
+}
+
+string jsonId(const jsonValue& id)
+{
+	if (id.kind == jsonValue::JSON_STRING)
+	{
+		return jsonString(id.text);
+	}
+	else if (id.kind == jsonValue::JSON_NUMBER)
+	{
+		return id.text;
+	}
+	return "null";
+}
+
+string uriDirectory(const string& uri)
+{
+	const string scheme = "file://";
+	if (uri.compare(0, scheme.size(), scheme) != 0)
+	{
+		return "";
+	}
+	size_t start = uri.find('/', scheme.size()); // skips the host, which is usually empty
+	size_t slash = uri.find_last_of('/');
+	if (start == string::npos || slash < start)
 	{
-		if (tokenType(&expression[foundLoc - 1]) == "int" && tokenType(&expression[foundLoc + 1]) == "int")
+		return "";
+	}
+	string directory;
+	for (size_t i = start; i <= slash; i++)
+	{
+		if (uri[i] == '%' && i + 2 < slash && isxdigit((unsigned char)uri[i + 1]) && isxdigit((unsigned char)uri[i + 2]))
 		{
-			expression[foundLoc] = "true";
-			expression.erase(expression.begin() + foundLoc + 1);
-			expression.erase(expression.begin() + foundLoc - 1);
+			directory += (char)stoi(uri.substr(i + 1, 2), NULL, 16);
+			i += 2;
 		}
 		else
 		{
-			showError(15);
-			return "e";
+			directory += uri[i];
 		}
-		
-		foundLoc = findFirst(expression, "<=");
 	}
-	
-	foundLoc = findFirst(expression, ">=");
-	while (foundLoc != -1)
+	return directory;
+}
+
+void writeInterface(string path, string sourceName)
+{
+	ofstream output(path.c_str(), ios::binary);
+	output.write(INTERFACE_MAGIC, sizeof(INTERFACE_MAGIC));
+	output.write((const char*)&INTERFACE_VERSION, sizeof(int));
+	unsigned long long hash = hashSource();
+	output.write((const char*)&hash, sizeof(hash));
+	int nameLength = sourceName.size();
+	output.write((const char*)&nameLength, sizeof(int));
+	output.write(sourceName.data(), nameLength);
+	int count = exportedNames.size();
+	output.write((const char*)&count, sizeof(int));
+	for (size_t n = 0; n < exportedNames.size(); n++)
 	{
-		if (tokenType(&expression[foundLoc - 1]) == "int" && tokenType(&expression[foundLoc + 1]) == "int")
-		{
-			expression[foundLoc] = "true";
-			expression.erase(expression.begin() + foundLoc + 1);
-			expression.erase(expression.begin() + foundLoc - 1);
-		}
-		else
+		symbolInfo* info = symbolTable.find(exportedNames[n])->second;
+		const vector<string>& arguments = info->getArguments();
+		int record[4] = {(int)exportedNames[n].size(), info->getScope(), info->getType(),
+			info->getSignature() == -1 ? -1 : (int)arguments.size()};
+		output.write((const char*)&record[0], sizeof(int));
+		output.write(exportedNames[n].data(), exportedNames[n].size());
+		output.write((const char*)&record[1], 3 * sizeof(int));
+		for (size_t a = 0; a < arguments.size(); a++)
 		{
-			showError(15);
-			return "e";
+			int argument = typeIndex(arguments[a]);
+			output.write((const char*)&argument, sizeof(int));
 		}
-		
-		foundLoc = findFirst(expression, ">=");
+	}
+}
+
+int loadInterface(string path)
+{
+	size_t size;
+	const char* file = mapFile(path, &size);
+	if (file == NULL)
+	{
+		return 20;
 	}
 	
-	foundLoc = findFirst(expression, "==");
-	while (foundLoc != -1)
+	// every read is checked against the end of the file, so a damaged interface is an error rather than a crash
+	const char* position = file;
+	const char* end = file + size;
+	int version;
+	unsigned long long hash;
+	int nameLength;
+	int count = 0;
+	size_t fixed = sizeof(INTERFACE_MAGIC) + sizeof(version) + sizeof(hash) + sizeof(nameLength);
+	bool valid = size >= fixed && memcmp(file, INTERFACE_MAGIC, sizeof(INTERFACE_MAGIC)) == 0;
+	if (valid)
 	{
-		string leftToken = tokenType(&expression[foundLoc - 1]);
-		string rightToken = tokenType(&expression[foundLoc + 1]);
-		if ((leftToken == "int" && rightToken == "int")
-		|| (leftToken == "char" && rightToken == "char")
-		|| (leftToken == "bool" && rightToken == "bool")
-		|| ((leftToken == "*int" || leftToken == "*null") && (rightToken == "*int" || rightToken == "*null"))
-		|| ((leftToken == "*char" || leftToken == "*null") && (rightToken == "*char" || rightToken == "*null")))
-		{
-			expression[foundLoc] = "true";
-			expression.erase(expression.begin() + foundLoc + 1);
-			expression.erase(expression.begin() + foundLoc - 1);
-		}
-		else
+		position += sizeof(INTERFACE_MAGIC);
+		memcpy(&version, position, sizeof(version));
+		memcpy(&hash, position + sizeof(version), sizeof(hash));
+		memcpy(&nameLength, position + sizeof(version) + sizeof(hash), sizeof(nameLength));
+		position = file + fixed;
+		valid = version == INTERFACE_VERSION && nameLength >= 0 && (size_t)(end - position) >= nameLength + sizeof(count);
+	}
+	if (valid) // the source must still be the one the interface was written from
+	{
+		size_t slash = path.find_last_of("/\\");
+		string sourcePath = path.substr(0, slash == string::npos ? 0 : slash + 1) + string(position, nameLength);
+		size_t sourceSize;
+		const char* source = mapFile(sourcePath, &sourceSize);
+		valid = source != NULL && hashName(source, sourceSize) == hash;
+		if (source != NULL)
 		{
-			showError(15);
-			return "e";
+			unmapFile(source, sourceSize);
 		}
-		
-		foundLoc = findFirst(expression, "==");
+		memcpy(&count, position + nameLength, sizeof(count));
+		position += nameLength + sizeof(count);
 	}
 	
-	foundLoc = findFirst(expression, "!=");
-	while (foundLoc != -1)
+	int error = valid ? 0 : 20;
+	for (int n = 0; error == 0 && n < count; n++)
 	{
-		string leftToken = tokenType(&expression[foundLoc - 1]);
-		string rightToken = tokenType(&expression[foundLoc + 1]);
-		if ((leftToken == "int" && rightToken == "int")
-		|| (leftToken == "char" && rightToken == "char")
-		|| (leftToken == "bool" && rightToken == "bool")
-		|| ((leftToken == "*int" || leftToken == "*null") && (rightToken == "*int" || rightToken == "*null"))
-		|| ((leftToken == "*char" || leftToken == "*null") && (rightToken == "*char" || rightToken == "*null")))
+		int nameLength;
+		int record[3];
+		if (end - position < (long)sizeof(int)
+		|| (memcpy(&nameLength, position, sizeof(int)), nameLength < 0)
+		|| end - position - sizeof(int) < nameLength + sizeof(record))
 		{
-			expression[foundLoc] = "true";
-			expression.erase(expression.begin() + foundLoc + 1);
-			expression.erase(expression.begin() + foundLoc - 1);
+			error = 20;
+			break;
 		}
-		else
+		string name(position + sizeof(int), nameLength);
+		position += sizeof(int) + nameLength;
+		memcpy(record, position, sizeof(record));
+		position += sizeof(record);
+		int argumentCount = max(record[2], 0);
+		if (record[1] < 0 || record[1] >= TYPE_COUNT || end - position < argumentCount * (long)sizeof(int))
 		{
-			showError(15);
-			return "e";
+			error = 20;
+			break;
 		}
 		
-		foundLoc = findFirst(expression, "!=");
-	}
-	
-	foundLoc = findFirst(expression, "&&");
-	while (foundLoc != -1)
-	{
-		if (tokenType(&expression[foundLoc - 1]) == "bool" && tokenType(&expression[foundLoc + 1]) == "bool")
-		{
-			expression[foundLoc] = "true";
-			expression.erase(expression.begin() + foundLoc + 1);
-			expression.erase(expression.begin() + foundLoc - 1);
-		}
-		else
+		unordered_map<string, symbolInfo*>::iterator it = symbolTable.find(name);
+		if (it != symbolTable.end() && (it->second)->getScope() == record[0]) // already declared
 		{
-			showError(15);
-			return "e";
+			error = record[2] == -1 ? 4 : 3;
+			break;
 		}
 		
-		foundLoc = findFirst(expression, "&&");
-	}
-	
-	foundLoc = findFirst(expression, "||");
-	while (foundLoc != -1)
-	{
-		if (tokenType(&expression[foundLoc - 1]) == "bool" && tokenType(&expression[foundLoc + 1]) == "bool")
+		symbolInfo* info;
+		if (record[2] == -1) // variable
 		{
-			expression[foundLoc] = "true";
-			expression.erase(expression.begin() + foundLoc + 1);
-			expression.erase(expression.begin() + foundLoc - 1);
+			info = new symbolInfo(record[0], record[1]);
 		}
 		else
 		{
-			showError(15);
-			return "e";
+			vector<string> arguments;
+			for (int a = 0; a < argumentCount; a++)
+			{
+				int argument;
+				memcpy(&argument, position, sizeof(int));
+				position += sizeof(int);
+				if (argument < 0 || argument >= TYPE_COUNT)
+				{
+					error = 20;
+					break;
+				}
+				arguments.push_back(typeNames[argument]);
+			}
+			if (error != 0)
+			{
+				break;
+			}
+			info = new symbolInfo(record[0], record[1], arguments, internSignature(typeNames[record[1]], &arguments));
+		}
+		if (symbolTable.insert(pair<string, symbolInfo*>(name, info)).second)
+		{
+			declarationLog.push_back(name);
 		}
-		
-		foundLoc = findFirst(expression, "||");
 	}
-	return tokenType(&expression[0]);
+	
+	unmapFile(file, size);
+	return error;
 }
 
-string tokenType(string* token)
+symbolInfo* findSymbol(const string& name)
 {
-	unordered_map<string, symbolInfo*>::iterator it = symbolTable.find(*token);
-	char first = (*token)[0];
-	string pointerAdd = "";
-	if (first == '*') // pointer "literal" signifier, can't exist in the input file but is used in the expression parser as a dummy value
-	{
-		pointerAdd = "*";
-		*token = token->substr(1, token->size());
-		first = (*token)[0];
-	}
-	
-	if (it != symbolTable.end()) // if in symbol table
+	operationsDone.lookups++;
+	unordered_map<string, symbolInfo*>::iterator it = symbolTable.find(name);
+	if (it != symbolTable.end())
 	{
-		return (it->second)->getType();
+		return it->second;
 	}
-	else if (token->find("\"") != string::npos) // if not in symbol table, must be a literal to be valid
+	if (preludeCount == 0)
 	{
-		return pointerAdd + "string";
+		return NULL;
 	}
-	else if (token->find("\'") != string::npos || *token == "]")
+	int index = findPreludeEntry(name, preludeNameIndex, preludeNameSlots, preludeRecords, PRELUDE_RECORD);
+	if (index == -1)
 	{
-		return pointerAdd + "char";
+		return NULL;
 	}
-	else if (first > 47 && first < 58)
+	symbolInfo* symbol = preludeSymbols[index].load(memory_order_acquire);
+	if (symbol != NULL)
 	{
-		if (token->find(".") != string::npos)
-		{
-			return pointerAdd + "double";
-		}
-		else
-		{
-			return pointerAdd + "int";
-		}
+		return symbol;
 	}
-	else if (*token == "true" || *token == "false")
+	
+	// the first use of the declaration makes its symbol, and a thread that loses the race to publish it uses the winner's
+	const int* record = preludeRecords + index * PRELUDE_RECORD;
+	if (record[3] == -1) // variable
 	{
-		return pointerAdd + "bool";
+		symbol = new symbolInfo(PRELUDE_SCOPE, record[2]);
 	}
 	else
 	{
-		if (pointerAdd == "*")
+		const int* argumentTypes = (const int*)(preludeImage + record[4]);
+		vector<string> arguments;
+		for (int a = 0; a < record[3]; a++)
 		{
-			return "*null"; // null pointer
+			arguments.push_back(typeNames[argumentTypes[a]]);
 		}
-		return "void";
+		symbol = new symbolInfo(PRELUDE_SCOPE, record[2], move(arguments), record[5]);
+	}
+	symbolInfo* published = NULL;
+	if (!preludeSymbols[index].compare_exchange_strong(published, symbol, memory_order_acq_rel, memory_order_acquire))
+	{
+		delete symbol;
+		symbol = published;
 	}
+	return symbol;
 }
 
-int findFirst(vector<string> vect, string search)
+int findPreludeEntry(const string& key, const int* index, int slots, const int* records, int recordInts)
 {
-	for (int i = 0; i < vect.size(); i++)
+	int mask = slots - 1;
+	for (int s = hashName(key.data(), key.size()) & mask; ; s = (s + 1) & mask)
 	{
-		if (vect[i] == search)
+		int entry = index[s];
+		if (entry == -1)
 		{
-			return i;
+			return -1;
+		}
+		const int* record = records + entry * recordInts;
+		if ((size_t)record[1] == key.size() && memcmp(preludeImage + record[0], key.data(), key.size()) == 0)
+		{
+			return entry;
 		}
 	}
-	return -1; // search not found
 }
 
-bool functionCheck(vector<string> function)
+bool writePrelude(string path)
 {
-	unordered_map<string, symbolInfo*>::iterator it = symbolTable.find(function[0]);
-	if (it != symbolTable.end() && (it->second)->getScope() <= fileScope)
+	vector<string> names = exportedNames;
+	sort(names.begin(), names.end());
+	
+	// each distinct signature's ID is its place in the image, in the order the sorted names first use them
+	vector<string> keys;
+	unordered_map<string, int> keyIds;
+	vector<int> signatures(names.size(), -1);
+	for (size_t n = 0; n < names.size(); n++)
 	{
-		vector<string> arguments;
-		string next = function[2]; // start past the first ( of the function call
-		int i = 0;
-		while (next != ")")
+		symbolInfo* info = symbolTable.find(names[n])->second;
+		if (info->getSignature() != -1)
 		{
-			if (next != ",")
+			const vector<string>& argumentNames = info->getArguments();
+			string key = typeNames[info->getType()] + "(";
+			for (size_t a = 0; a < argumentNames.size(); a++)
 			{
-				arguments.push_back(tokenType(&next));
+				key += (a > 0 ? "," : "") + argumentNames[a];
 			}
-			i++;
-			next = function[2 + i];
+			key += ')';
+			pair<unordered_map<string, int>::iterator, bool> added = keyIds.insert(pair<string, int>(key, keys.size()));
+			if (added.second)
+			{
+				keys.push_back(key);
+			}
+			signatures[n] = added.first->second;
 		}
-		
-		vector<string> storedArguments = (it->second)->getArguments();
-		if (arguments.size() != storedArguments.size())
+	}
+	
+	// the index slots are a power of two, at least twice the entries so probes stay short and end at an empty slot
+	int nameSlots = 1;
+	while (nameSlots < (int)names.size() * 2)
+	{
+		nameSlots *= 2;
+	}
+	int signatureSlots = 1;
+	while (signatureSlots < (int)keys.size() * 2)
+	{
+		signatureSlots *= 2;
+	}
+	vector<int> nameIndex(nameSlots, -1);
+	vector<int> signatureIndex(signatureSlots, -1);
+	auto place = [](vector<int>* index, const string& key, int record)
+	{
+		int mask = index->size() - 1;
+		int s = hashName(key.data(), key.size()) & mask;
+		while ((*index)[s] != -1)
 		{
-			showError(6);
-			return false;
+			s = (s + 1) & mask;
+		}
+		(*index)[s] = record;
+	};
+	
+	// the tables and arguments are laid out first, so the offsets of the names and keys are known
+	int header[5] = {PRELUDE_VERSION, (int)names.size(), (int)keys.size(), nameSlots, signatureSlots};
+	vector<int> records;
+	vector<int> signatureRecords;
+	vector<int> arguments;
+	string text;
+	int argumentsStart = sizeof(PRELUDE_MAGIC) + sizeof(header) + (names.size() * PRELUDE_RECORD
+		+ keys.size() * PRELUDE_SIGNATURE_RECORD + nameSlots + signatureSlots) * sizeof(int);
+	for (size_t n = 0; n < names.size(); n++)
+	{
+		symbolInfo* info = symbolTable.find(names[n])->second;
+		const vector<string>& argumentNames = info->getArguments();
+		records.push_back(text.size()); // made relative to the start of the image below
+		records.push_back(names[n].size());
+		records.push_back(info->getType());
+		records.push_back(info->getSignature() == -1 ? -1 : (int)argumentNames.size());
+		records.push_back(argumentsStart + arguments.size() * sizeof(int));
+		records.push_back(signatures[n]);
+		for (size_t a = 0; a < argumentNames.size(); a++)
+		{
+			arguments.push_back(typeIndex(argumentNames[a]));
 		}
-		for (i = 0; i < arguments.size(); i++)
+		text += names[n];
+		place(&nameIndex, names[n], n);
+	}
+	for (size_t k = 0; k < keys.size(); k++)
+	{
+		signatureRecords.push_back(text.size());
+		signatureRecords.push_back(keys[k].size());
+		text += keys[k];
+		place(&signatureIndex, keys[k], k);
+	}
+	int textStart = argumentsStart + arguments.size() * sizeof(int);
+	for (size_t n = 0; n < names.size(); n++)
+	{
+		records[n * PRELUDE_RECORD] += textStart;
+	}
+	for (size_t k = 0; k < keys.size(); k++)
+	{
+		signatureRecords[k * PRELUDE_SIGNATURE_RECORD] += textStart;
+	}
+	
+	ofstream output(path.c_str(), ios::binary);
+	output.write(PRELUDE_MAGIC, sizeof(PRELUDE_MAGIC));
+	output.write((const char*)header, sizeof(header));
+	output.write((const char*)records.data(), records.size() * sizeof(int));
+	output.write((const char*)signatureRecords.data(), signatureRecords.size() * sizeof(int));
+	output.write((const char*)nameIndex.data(), nameIndex.size() * sizeof(int));
+	output.write((const char*)signatureIndex.data(), signatureIndex.size() * sizeof(int));
+	output.write((const char*)arguments.data(), arguments.size() * sizeof(int));
+	output.write(text.data(), text.size());
+	return output.good();
+}
+
+bool loadPrelude(string path)
+{
+	if (preludeImage != NULL)
+	{
+		return false;
+	}
+	size_t size;
+	const char* image = mapFile(path, &size);
+	if (image == NULL)
+	{
+		return false;
+	}
+	
+	// everything is checked once here, so lookups can trust the image
+	int header[5];
+	size_t tablesStart = sizeof(PRELUDE_MAGIC) + sizeof(header);
+	bool valid = size >= tablesStart && memcmp(image, PRELUDE_MAGIC, sizeof(PRELUDE_MAGIC)) == 0;
+	if (valid)
+	{
+		memcpy(header, image + sizeof(PRELUDE_MAGIC), sizeof(header));
+		valid = header[0] == PRELUDE_VERSION && header[1] >= 0 && header[2] >= 0 && header[3] > header[1]
+			&& header[4] > header[2] && (header[3] & (header[3] - 1)) == 0 && (header[4] & (header[4] - 1)) == 0
+			&& (size - tablesStart) / sizeof(int) >= (size_t)header[1] * PRELUDE_RECORD
+				+ (size_t)header[2] * PRELUDE_SIGNATURE_RECORD + header[3] + header[4];
+	}
+	if (!valid)
+	{
+		unmapFile(image, size);
+		return false;
+	}
+	const int* records = (const int*)(image + tablesStart);
+	const int* signatures = records + (size_t)header[1] * PRELUDE_RECORD;
+	const int* nameIndex = signatures + (size_t)header[2] * PRELUDE_SIGNATURE_RECORD;
+	const int* signatureIndex = nameIndex + header[3];
+	for (int n = 0; valid && n < header[1]; n++)
+	{
+		const int* record = records + n * PRELUDE_RECORD;
+		valid = record[0] >= 0 && record[1] >= 0 && (size_t)record[0] <= size && (size_t)record[1] <= size - record[0]
+			&& record[2] >= 0 && record[2] < TYPE_COUNT
+			&& record[3] >= -1 && record[4] >= 0 && record[4] % sizeof(int) == 0 && (size_t)record[4] <= size
+			&& (size_t)max(record[3], 0) <= (size - record[4]) / sizeof(int)
+			&& (record[3] == -1 ? record[5] == -1 : record[5] >= 0 && record[5] < header[2]);
+		for (int a = 0; valid && a < record[3]; a++)
 		{
-			if (arguments[i] != storedArguments[i])
-			{
-				showError(7);
-				return false;
-			}
+			int argument = ((const int*)(image + record[4]))[a];
+			valid = argument >= 0 && argument < TYPE_COUNT;
 		}
 	}
-	else // function does not exist in the current scope
+	for (int k = 0; valid && k < header[2]; k++)
 	{
-		showError(5);
+		const int* signature = signatures + k * PRELUDE_SIGNATURE_RECORD;
+		valid = signature[0] >= 0 && signature[1] >= 0 && (size_t)signature[0] <= size
+			&& (size_t)signature[1] <= size - signature[0];
+	}
+	// every probe must end at an empty slot, and every slot that is not empty must hold a record
+	const int* indexes[2] = {nameIndex, signatureIndex};
+	for (int i = 0; valid && i < 2; i++)
+	{
+		int slots = header[3 + i];
+		int entries = header[1 + i];
+		bool empty = false;
+		for (int s = 0; valid && s < slots; s++)
+		{
+			empty = empty || indexes[i][s] == -1;
+			valid = indexes[i][s] >= -1 && indexes[i][s] < entries;
+		}
+		valid = valid && empty;
+	}
+	if (!valid)
+	{
+		unmapFile(image, size);
 		return false;
 	}
+	
+	// the image stays mapped until the process exits, and its symbols are only made as they are used
+	preludeImage = image;
+	preludeCount = header[1];
+	preludeRecords = records;
+	preludeSignatureCount = header[2];
+	preludeSignatures = signatures;
+	preludeNameIndex = nameIndex;
+	preludeNameSlots = header[3];
+	preludeSignatureIndex = signatureIndex;
+	preludeSignatureSlots = header[4];
+	preludeSymbols = new atomic<symbolInfo*>[max(preludeCount, 1)]();
 	return true;
 }
 
+const char* mapFile(string path, size_t* size)
+{
+#ifndef _WIN32
+	int descriptor = open(path.c_str(), O_RDONLY);
+	if (descriptor == -1)
+	{
+		return NULL;
+	}
+	struct stat status;
+	void* file = MAP_FAILED;
+	if (fstat(descriptor, &status) == 0)
+	{
+		*size = status.st_size;
+		file = *size == 0 ? (void*)"" : mmap(NULL, *size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+	}
+	close(descriptor);
+	return file == MAP_FAILED ? NULL : (const char*)file;
+#else
+	ifstream input(path.c_str(), ios::binary | ios::ate);
+	if (!input)
+	{
+		return NULL;
+	}
+	*size = input.tellg();
+	char* file = new char[*size + 1];
+	input.seekg(0);
+	input.read(file, *size);
+	return file;
+#endif
+}
+
+void unmapFile(const char* file, size_t size)
+{
+#ifndef _WIN32
+	if (size > 0)
+	{
+		munmap((void*)file, size);
+	}
+#else
+	delete[] file;
+#endif
+}
+
 void showError(int code)
 {
-	cout << "Error " << code << " on line " << lineNo << " : ";
+	int line;
+	int column;
+	findLocation(errorOffset, &line, &column);
+	lastError = code;
+	*diagnostics << "Error " << code << " on line " << line << ", column " << column << " : " << errorMessage(code) << endl;
+	*diagnostics << "Type check failed.";
+}
+
+const char* errorMessage(int code)
+{
 	switch(code)
 	{
 		case 1:
-			cout << "Multiple Main cannot exist." << endl;
-			break;
+			return "Multiple Main cannot exist.";
 		case 2:
-			cout << "Main cannot have arguments." << endl;
-			break;
+			return "Main cannot have arguments.";
 		case 3:
-			cout << "Procedure appears multiple times." << endl;
-			break;
+			return "Procedure appears multiple times.";
 		case 4:
-			cout << "Variable appears multiple times." << endl;
-			break;
+			return "Variable appears multiple times.";
 		case 5:
-			cout << "This procedure does not exist in the current scope." << endl;
-			break;
+			return "This procedure does not exist in the current scope.";
 		case 6:
-			cout << "The number of arguments passed is incorrect." << endl;
-			break;
+			return "The number of arguments passed is incorrect.";
 		case 7:
-			cout << "The type of the arguments passed are incorrect." << endl;
-			break;
+			return "The type of the arguments passed are incorrect.";
 		case 8:
-			cout << "Invalid return type." << endl;
-			break;
+			return "Invalid return type.";
 		case 9:
-			cout << "This procedure does not return the same data type as what it is being assigned to." << endl;
-			break;
+			return "This procedure does not return the same data type as what it is being assigned to.";
 		case 10:
-			cout << "if statement arguments must be of type bool." << endl;
-			break;
+			return "if statement arguments must be of type bool.";
 		case 11:
-			cout << "while statement arguments must be of type bool." << endl;
-			break;
+			return "while statement arguments must be of type bool.";
 		case 12:
-			cout << "Cannot use a non-integer value to index a String." << endl;
-			break;
+			return "Cannot use a non-integer value to index a String.";
 		case 13:
-			cout << "Non-String variables cannot be indexed." << endl;
-			break;
+			return "Non-String variables cannot be indexed.";
 		case 14:
-			cout << "Invalid assignment due to mismatched data types." << endl;
-			break;
+			return "Invalid assignment due to mismatched data types.";
 		case 15:
-			cout << "Incorrect operands." << endl;
-			break;
+			return "Incorrect operands.";
 		case 16:
-			cout << "Can only add and subtract to pointers." << endl;
-			break;
+			return "Can only add and subtract to pointers.";
 		case 17:
-			cout << "Cannot use addressOf on non-integer/char/string-index values." << endl;
-			break;
+			return "Cannot use addressOf on non-integer/char/string-index values.";
 		case 18:
-			cout << "Cannot use deref on non-integer-pointer/char-pointer values." << endl;
-			break;
+			return "Cannot use deref on non-integer-pointer/char-pointer values.";
+		case 19:
+			return "Unexpected end of file.";
+		case 20:
+			return "The imported module's interface could not be loaded.";
+		case 21:
+			return "The imported module failed its check.";
 		default:
-			cout << "Undefined error." << endl;
-			break;
+			return "Undefined error.";
+	}
+}
+
+#ifdef TRACK_ALLOCATIONS
+// Each allocation is preceded by a header recording its size and the phase it was made in, so it can be taken
+// off the right phase when it is freed. The header is a multiple of the largest alignment new must honour.
+struct alignas(max_align_t) allocationHeader
+{
+	size_t size;
+	int phase;
+};
+
+// Totals for each phase, and for the whole run at index PHASE_COUNT. Zeroed before any constructor runs.
+atomic<long long> allocationCounts[PHASE_COUNT + 1];
+atomic<long long> allocatedBytes[PHASE_COUNT + 1];
+atomic<long long> liveBytes[PHASE_COUNT + 1];
+atomic<long long> peakBytes[PHASE_COUNT + 1];
+
+// Records an allocation of the passed size in the current phase.
+// Returns the memory for the caller, or NULL if none is left.
+// Preconditions: None.
+// Postconditions: None.
+void* trackedAllocate(size_t size)
+{
+	allocationHeader* header = (allocationHeader*)malloc(sizeof(allocationHeader) + size);
+	if (header == NULL)
+	{
+		return NULL;
+	}
+	header->size = size;
+	header->phase = currentPhase;
+	int counters[2] = {currentPhase, PHASE_COUNT};
+	for (int c = 0; c < 2; c++)
+	{
+		int phase = counters[c];
+		allocationCounts[phase]++;
+		allocatedBytes[phase] += size;
+		long long live = liveBytes[phase] += size;
+		long long peak = peakBytes[phase];
+		while (live > peak && !peakBytes[phase].compare_exchange_weak(peak, live))
+		{
+		}
+	}
+	return header + 1;
+}
+
+// Records that the passed allocation was freed, then frees it.
+// Preconditions: The pointer came from trackedAllocate, or is NULL.
+// Postconditions: None.
+void trackedFree(void* memory)
+{
+	if (memory == NULL)
+	{
+		return;
+	}
+	allocationHeader* header = (allocationHeader*)memory - 1;
+	liveBytes[header->phase] -= header->size;
+	liveBytes[PHASE_COUNT] -= header->size;
+	free(header);
+}
+
+void* operator new(size_t size)
+{
+	void* memory = trackedAllocate(size);
+	if (memory == NULL)
+	{
+		throw bad_alloc();
+	}
+	return memory;
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void* operator new(size_t size, const nothrow_t&) noexcept
+{
+	return trackedAllocate(size);
+}
+
+void* operator new[](size_t size, const nothrow_t&) noexcept
+{
+	return trackedAllocate(size);
+}
+
+void operator delete(void* memory) noexcept
+{
+	trackedFree(memory);
+}
+
+void operator delete[](void* memory) noexcept
+{
+	trackedFree(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept
+{
+	trackedFree(memory);
+}
+
+void operator delete[](void* memory, size_t) noexcept
+{
+	trackedFree(memory);
+}
+
+void reportAllocations()
+{
+	cout << endl << "Allocations by phase (peak is the most bytes allocated in the phase and not yet freed):" << endl;
+	cout << left << setw(14) << "phase" << right << setw(14) << "allocations" << setw(16) << "bytes" << setw(16) << "peak bytes" << endl;
+	for (int phase = 0; phase <= PHASE_COUNT; phase++)
+	{
+		cout << left << setw(14) << (phase == PHASE_COUNT ? "total" : phaseNames[phase]) << right
+			<< setw(14) << allocationCounts[phase].load() << setw(16) << allocatedBytes[phase].load()
+			<< setw(16) << peakBytes[phase].load() << endl;
 	}
-	cout << "Type check failed.";
 }
+#else
+void reportAllocations()
+{
+}
+#endif